@@ -0,0 +1,52 @@
+#
+# Copyright 2012 Elovalo project group 
+# 
+# This file is part of Elovalo.
+# 
+# Elovalo is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# Elovalo is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with Elovalo.  If not, see <http:#www.gnu.org/licenses/>.
+#
+
+
+"""Packet framing of the PACKET_FRAME command. A packet consists of
+payload length, payload and CRC-16 of both, encoded with Consistent
+Overhead Byte Stuffing and ended with a zero byte."""
+
+import binascii
+import struct
+
+
+def packet(payload):
+    """Returns payload bytearray framed as a packet"""
+    data = bytearray(struct.pack('<H', len(payload))) + payload
+    # CRC-16 like in ZCL: polynomial 0x1021, initial value 0xffff
+    crc = binascii.crc_hqx(bytes(data), 0xffff)
+    data += bytearray(struct.pack('<H', crc))
+    return encode(data) + bytearray(1)
+
+
+def encode(data):
+    """Returns data with zero bytes stuffed away"""
+    out = bytearray()
+    start = 0
+
+    while True:
+        end = start
+        while end < len(data) and data[end] != 0 and end - start < 254:
+            end += 1
+        out.append(end - start + 1)
+        out.extend(data[start:end])
+        if end == len(data):
+            return out
+        # Zero is implied by a group shorter than 254 bytes
+        start = end + 1 if end - start < 254 else end
@@ -44,6 +44,11 @@ Command = configtuple.ConfigTuple('Command', {
     'LIST_EFFECTS'    : 'e',
     'CHANGE_EFFECT'   : 'E',
     'SERIAL_FRAME'    : 'F',
+    'DELTA_FRAME'     : 'D',
+    'PACKET_FRAME'    : 'K',
+    'WRITE_LAYERS'    : 'L',
+    'WRITE_BOX'       : 'V',
+    'COMMIT_FRAME'    : 'M',
     'GET_TIME'        : 't',
     'SET_TIME'        : 'T',
     'SET_SENSOR'      : 'S',
@@ -52,6 +57,13 @@ Command = configtuple.ConfigTuple('Command', {
     'READ_CRONTAB'    : 'c',
     'WRITE_CRONTAB'   : 'C',
     'SELECT_PLAYLIST' : 'P',
+    'GET_STATS'       : 's',
+    'GET_ORIENTATION' : 'o',
+    'SET_ORIENTATION' : 'O',
+    'GET_CALIBRATION' : 'g',
+    'SET_CALIBRATION' : 'G',
+    'GET_POWER'       : 'w',
+    'SET_POWER'       : 'W',
     'NOTHING'         : '*' # May be used to end binary transmission
 })
 
@@ -63,7 +75,9 @@ Report = configtuple.ConfigTuple('Report', {
     'ANSWERING'    : '(', # Command received, starting to process input
     'READY'        : ')', # Processing of command is ready
     'BOOT'         : 'B', # Device has been (re)booted
-    'FLIP'         : '%' # Frame has been flipped, ready to receive new
+    'FLIP'         : '%', # Frame has been flipped, ready to receive new
+    'CREDIT'       : '+', # Followed by byte count of next frame to send
+    'BAD_PACKET'   : '!' # Damaged packet was dropped
 })
 
 # Typical answers to commands. Use of these is command-specific
@@ -39,17 +39,25 @@ class Connection():
             cmd.append(kind)
         else:
             cmd = bytearray()
+        cmd.extend(self.escape(body))
+        self.write(cmd)
+
+    def escape(self, body):
+        data = bytearray()
         try:
+            # Strings give characters and bytearrays integers
             for i in body:
-                cmd.append(i)
-                if i == config.Core.ESCAPE:
-                    cmd.append(config.Core.LITERAL_ESCAPE)
+                data.append(i)
+                if i in (config.Core.ESCAPE, ord(config.Core.ESCAPE)):
+                    data.append(config.Core.LITERAL_ESCAPE)
         except TypeError:
-            cmd.append(body)
+            data.append(body)
+        return data
 
+    def write(self, data):
         if config.DEBUG:
-            print("Sent: {0} | {1}".format(cmd, binascii.hexlify(cmd)))
-        self.ser.write(cmd)
+            print("Sent: {0} | {1}".format(data, binascii.hexlify(data)))
+        self.ser.write(data)
         self.ser.flush()
 
     def read(self):
@@ -0,0 +1,65 @@
+#
+# Copyright 2012 Elovalo project group 
+# 
+# This file is part of Elovalo.
+# 
+# Elovalo is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# Elovalo is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with Elovalo.  If not, see <http:#www.gnu.org/licenses/>.
+#
+
+
+"""Delta coding of frames for the DELTA_FRAME command. A frame is
+coded as XOR against the previous one. Token 0x00-0x7f is followed by
+that many plus one literal bytes and token 0x80-0xff skips that many
+minus 0x7f unchanged bytes."""
+
+MAX_RUN = 128
+
+# Zero bytes shorter than this are cheaper to send inside a literal
+MIN_SKIP = 3
+
+
+def encode(prev, frame):
+    """Returns frame coded against prev. Both are bytearrays of the
+    same length. Use zeros as prev for the first frame."""
+    delta = bytearray(a ^ b for a, b in zip(prev, frame))
+    out = bytearray()
+    i = 0
+
+    while i < len(delta):
+        skip = zero_run(delta, i)
+        if skip >= MIN_SKIP or i + skip == len(delta):
+            n = min(skip, MAX_RUN)
+            out.append(0x80 + n - 1)
+            i += n
+            continue
+
+        # Literal runs until enough unchanged bytes follow
+        start = i
+        while i < len(delta) and i - start < MAX_RUN:
+            skip = zero_run(delta, i)
+            if skip >= MIN_SKIP or i + skip == len(delta):
+                break
+            i += max(skip, 1)
+        i = min(i, start + MAX_RUN)
+        out.append(i - start - 1)
+        out.extend(delta[start:i])
+
+    return out
+
+
+def zero_run(data, i):
+    n = 0
+    while i + n < len(data) and data[i + n] == 0:
+        n += 1
+    return n
@@ -142,6 +142,34 @@ class EloParser():
             print("Received time value was too short")
             return time.localtime(0)
     
+    def parse_stats(self):
+        self.parse_response()
+        try:
+            return struct.unpack('<LHHHB', self.resp_string()[:11])
+        except struct.error:
+            print("Received statistics were too short")
+            return (0, 0, 0, 0, 2)
+
+    def parse_orientation(self):
+        self.parse_response()
+        try:
+            return ord(self.resp_string()[0])
+        except IndexError:
+            print("Received orientation was too short")
+            return 0
+
+    def parse_power(self):
+        self.parse_response()
+        try:
+            return struct.unpack('<BB', self.resp_string()[:2])
+        except struct.error:
+            print("Received power values were too short")
+            return (0, 0)
+
+    def parse_calibration(self):
+        self.parse_response()
+        return list(self.resp_data)
+
     def parse_flip(self):
         self.parse_response()
         r = self.resp_data
@@ -24,9 +24,12 @@ import struct
 import sys
 import time
 
+import cobs
 import config
 import connection
+import delta
 import parser
+import region
 
 class EloCmd(cmd.Cmd):
     intro  = 'Type help to see available commands'
@@ -66,14 +69,83 @@ class EloCmd(cmd.Cmd):
 
     def do_file(self, line):
         """Opens one or multiple effect data files and send their contents to the serial port"""
-        
-        # Prepare serial port for effect uploading
-        self.conn.send_command(config.Command.SERIAL_FRAME)
+        self.upload(config.Command.SERIAL_FRAME, line,
+                    lambda prev, frame: self.conn.escape(frame))
+
+    def do_stream(self, line):
+        """Like file, but sends only changes between frames. Much
+        faster for animations which change little at a time."""
+        self.upload(config.Command.DELTA_FRAME, line,
+                    lambda prev, frame: self.conn.escape(
+                        delta.encode(prev, frame)))
+
+    def do_packet(self, line):
+        """Like file, but sends frames as COBS packets with a CRC.
+        Damaged frames are dropped."""
+        self.upload(config.Command.PACKET_FRAME, line,
+                    lambda prev, frame: cobs.packet(frame),
+                    end=bytearray(1))
+
+    def upload(self, command, line, code, end=None):
+        """Sends frames of effect files coded by code(prev, frame)
+        and then end, if given. When the device grants credit, the
+        beginning of the next frame is sent while the previous one
+        waits for flip. Prints the link utilization in the end, not
+        counting the time slept to keep the frame rate."""
+        self.conn.send_command(command)
         # FIXME: does not validate size
         self.response_parser().parse_response()
 
-        t = time.time()
+        start = time.time()
+        t = start
+        slept = 0.0
+        sent = 0
+        frames = self.frames(line, code)
+        fps, body = next(frames, (None, None))
+        head = 0 # Bytes of body sent on credit
+
+        while body is not None:
+            self.conn.write(body[head:])
+            sent += len(body) - head
+            fps, body = next(frames, (None, None))
+            head = 0
+
+            r = self.conn.ser.read(1)
+            if r == config.Report.BAD_PACKET:
+                print("Frame was damaged and dropped")
+                r = self.conn.ser.read(1)
+            if r == config.Report.CREDIT:
+                credit = ord(self.conn.ser.read(1))
+                if body is not None:
+                    head = min(credit, len(body))
+                    self.conn.write(body[:head])
+                    sent += head
+                r = self.conn.ser.read(1)
+            if r != config.Report.FLIP:
+                print("No FLIP in 1 second. Is cube connected?")
+                break
+            if body is None:
+                break
+            t = t + (1.0/fps)
+            d = t - time.time()
+            if d > 0:
+                time.sleep(d)
+                slept += d
 
+        if end is not None:
+            self.conn.write(end)
+            sent += len(end)
+
+        # A byte takes ten bits with start and stop bits
+        elapsed = time.time() - start - slept
+        if elapsed > 0:
+            print("Sent {0} bytes in {1:.1f} s, link utilization "
+                  "{2:.0f} %".format(sent, elapsed, 100.0 * sent * 10 /
+                                     config.BAUDRATE / elapsed))
+
+    def frames(self, line, code):
+        """Yields frame rates and coded frames of effect files"""
+        prev = None
         for file in line.split():
             with open(file, 'r') as f:
                 m = f.read(3)
@@ -82,18 +154,33 @@ class EloCmd(cmd.Cmd):
                     return
                 fps = struct.unpack(">B", f.read(1))[0]
                 frame_size = struct.unpack(">H", f.read(2))[0]
-                
+
+                # The first frame is coded against a black one
+                if prev is None:
+                    prev = bytearray(frame_size)
+
                 while True:
-                    frame = f.read(frame_size)
+                    frame = bytearray(f.read(frame_size))
                     if not frame: break
-                    self.conn.send_command('', frame)
-                    if self.conn.ser.read(1) != '%':
-                        print("No FLIP in 1 second. Is cube connected?")
-                        return
-                    t = t + (1.0/fps)
-                    d = t - time.time()
-                    if d > 0:
-                        time.sleep(d)
+                    yield fps, code(prev, frame)
+                    prev = frame
+
+    def do_box(self, line):
+        """Set a box of voxels to one intensity and show it. Takes
+        corner x y z, size w h d and intensity (0-4095). Other voxels
+        keep their intensities."""
+        try:
+            x, y, z, w, h, d, i = [int(v) for v in line.split()]
+        except ValueError:
+            print("Usage: box x y z w h d intensity")
+            return
+
+        body = region.box(x, y, z, w, h, d, [i] * (w * h * d))
+        self.conn.send_command(config.Command.WRITE_BOX, body)
+        if not self.response_parser().parse_ok():
+            return
+        self.conn.send_command(config.Command.COMMIT_FRAME)
+        self.response_parser().parse_ok()
 
     def do_time(self, line):
         """Get and synchronize device time"""
@@ -113,6 +200,92 @@ class EloCmd(cmd.Cmd):
     def complete_time(self, text, line, begidx, endidx):
         return ['sync']
 
+    def do_stats(self, line):
+        """Show frame pipeline counters since the previous query"""
+        self.conn.send_command(config.Command.GET_STATS)
+        flip_wait, flips, draws, held, buffers = \
+            self.response_parser().parse_stats()
+        print("{0} frames drawn, {1} flipped, waited {2} layer periods "
+              "for flips, {3} layers held, {4} buffers".format(
+                  draws, flips, flip_wait, held, buffers))
+
+    def do_orientation(self, line):
+        """Get or set cube orientation (0-47). Value is 8 * permutation
+        + flips. Permutations 0-5 put logical axes XYZ, XZY, YXZ, YZX,
+        ZXY or ZYX along the physical X, Y and Z. Bits 0-2 of flips
+        reverse physical X, Y and Z. The setting is stored to EEPROM."""
+        if line:
+            try:
+                o = chr(int(line))
+            except ValueError:
+                print("Incorrect orientation")
+                return
+            self.conn.send_command(config.Command.SET_ORIENTATION, o)
+            self.response_parser().parse_ok()
+            return
+
+        self.conn.send_command(config.Command.GET_ORIENTATION)
+        print("orientation {0}".format(
+            self.response_parser().parse_orientation()))
+
+    def do_power(self, line):
+        """Get or set power budget (0-255). Load is the mean intensity
+        of the shown frame, where 255 is every LED at full intensity.
+        Frames with load above the budget are dimmed to draw the same
+        current as a frame at the budget. 255 disables limiting. The
+        budget is stored to EEPROM."""
+        if line:
+            try:
+                b = chr(int(line))
+            except ValueError:
+                print("Incorrect power budget")
+                return
+            self.conn.send_command(config.Command.SET_POWER, b)
+            self.response_parser().parse_ok()
+            return
+
+        self.conn.send_command(config.Command.GET_POWER)
+        load, budget = self.response_parser().parse_power()
+        print("load {0}, budget {1}".format(load, budget))
+
+    def do_calibration(self, line):
+        """Get or set channel calibration. Without arguments, shows
+        the scale of every channel in rows of physical Y. Setting
+        takes a file of whitespace separated values (0-255), one for
+        each channel, where 255 is full intensity. 'reset' sets all
+        channels to full intensity. The table is stored to EEPROM."""
+        self.conn.send_command(config.Command.GET_CALIBRATION)
+        table = self.response_parser().parse_calibration()
+        if not table:
+            print("Received calibration was too short")
+            return
+
+        if not line:
+            side = int(len(table) ** 0.5)
+            for y in range(0, len(table), side):
+                print(" ".join("{0:3}".format(c) for c in table[y:y+side]))
+            return
+
+        if line == "reset":
+            values = [255] * len(table)
+        else:
+            try:
+                with open(line, 'r') as f:
+                    values = [int(v) for v in f.read().split()]
+            except (IOError, ValueError):
+                print("Unable to read calibration file")
+                return
+
+        if len(values) != len(table) or \
+           any(v < 0 or v > 255 for v in values):
+            print("Calibration needs {0} values between 0 and 255".format(
+                len(table)))
+            return
+
+        self.conn.send_command(config.Command.SET_CALIBRATION,
+                               bytearray(values))
+        self.response_parser().parse_ok()
+
     def do_stop(self, line):
         """Send stop-signal to the device"""
         self.conn.send_command(config.Command.STOP)
@@ -0,0 +1,40 @@
+#
+# Copyright 2012 Elovalo project group 
+# 
+# This file is part of Elovalo.
+# 
+# Elovalo is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# Elovalo is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with Elovalo.  If not, see <http:#www.gnu.org/licenses/>.
+#
+
+
+"""Partial frame updates. WRITE_LAYERS and WRITE_BOX draw on a copy
+of the shown frame and COMMIT_FRAME shows the updates together."""
+
+import struct
+
+
+def box(x, y, z, w, h, d, intensities):
+    """Returns the body of WRITE_BOX. Intensities (0-4095) go X
+    first, then Y and Z."""
+    out = bytearray(struct.pack('<6B', x, y, z, w, h, d))
+    for i in range(0, len(intensities), 2):
+        a = intensities[i]
+        out.append(a >> 4)
+        if i + 1 < len(intensities):
+            b = intensities[i + 1]
+            out.append((a & 0x0f) << 4 | b >> 8)
+            out.append(b & 0xff)
+        else:
+            out.append((a & 0x0f) << 4)
+    return out
@@ -63,4 +63,8 @@ def avr_build_env(flags=''):
     env.Append(LIBS='m')
     if GetOption('use_asm'):
         env.Append(CPPDEFINES='ASM_ISRS')
+    if GetOption('triple_buffer'):
+        env.Append(CPPDEFINES='TRIPLE_BUFFER')
+    if GetOption('voxel_lut'):
+        env.Append(CPPDEFINES='VOXEL_LUT')
     return env
@@ -126,9 +126,22 @@ class SourceFiles(object):
     def union(self):
         struct = lambda f: f.variables.replace('vars', f.name)
 
-        ret = ['static union {']
+        # Overlays run together with another effect, so their
+        # variables must not share memory with the other effects
+        ret = ['static struct {', 'union {']
 
-        ret.extend([struct(f) for f in self._files if f.variables])
+        ret.extend([struct(f) for f in self._files
+                    if f.variables and not f.overlay])
+
+        ret.append('};')
+
+        overlays = [struct(f) for f in self._files
+                    if f.variables and f.overlay]
+
+        if overlays:
+            ret.append('union {')
+            ret.extend(overlays)
+            ret.append('};')
 
         ret.append('} vars;')
 
@@ -138,11 +151,16 @@ class SourceFiles(object):
     def effects(self):
         definition = lambda f: '\t{ s_' + f.name + ', ' + init(f) + ', ' + \
             effect(f) + ', ' + flip(f) + ', ' + f.max_fps + ', ' + \
-            dynamic_text(f) + ' },'
+            dynamic_text(f) + ', ' + palette(f) + ', ' + tween(f) + ', ' + \
+            dither(f) + ', ' + feedback(f) + ' },'
         init = lambda f: '&init_' + f.name if f.init else 'NULL'
         effect = lambda f: '&effect_' + f.name if f.effect else 'NULL'
-        flip = lambda f: 'FLIP' if f.flip else 'NO_FLIP'
+        flip = lambda f: 'JIT' if f.jit else 'FLIP' if f.flip else 'NO_FLIP'
         dynamic_text = lambda f: 'true' if f.dynamic_text else 'false'
+        palette = lambda f: 'true' if f.palette else 'false'
+        tween = lambda f: 'true' if f.tween else 'false'
+        dither = lambda f: 'true' if f.dither else 'false'
+        feedback = lambda f: 'true' if f.feedback else 'false'
 
         ret = ['const effect_t effects[] PROGMEM = {']
 
@@ -177,6 +195,12 @@ class SourceFile(object):
         self.init = self._block(content, 'init')
         self.effect = self._block(content, 'effect')
         self.flip = self._flip(content)
+        self.jit = self._jit(content)
+        self.palette = self._palette(content)
+        self.overlay = self._overlay(content)
+        self.tween = self._tween(content)
+        self.dither = self._dither(content)
+        self.feedback = self._feedback(content)
         self.max_fps = self._max_fps(content)
         self.dynamic_text = self._dynamic_text(content)
         self.variables = self._variables(content)
@@ -201,6 +225,50 @@ class SourceFile(object):
     def _flip(self, c):
         return filter(lambda line: 'flip' in line['types'], c)
 
+    def _jit(self, c):
+        jit = filter(lambda line: 'jit' in line['types'], c)
+
+        if jit and not filter(lambda line: 'CANVAS(' in line['content'], c):
+            raise Exception(self.name + ': JIT needs a CANVAS effect')
+
+        return jit
+
+    def _palette(self, c):
+        palette = filter(lambda line: 'palette' in line['types'], c)
+
+        if palette and self.jit:
+            raise Exception(self.name + ': JIT slots do not support PALETTE')
+
+        return palette
+
+    def _overlay(self, c):
+        overlay = filter(lambda line: 'overlay' in line['types'], c)
+
+        if overlay and self.palette:
+            raise Exception(self.name + ': PALETTE effects can not overlay')
+
+        return overlay
+
+    def _tween(self, c):
+        tween = filter(lambda line: 'tween' in line['types'], c)
+
+        if tween and (self.jit or not self.flip):
+            raise Exception(self.name + ': TWEEN requires FLIP')
+
+        return tween
+
+    def _dither(self, c):
+        dither = filter(lambda line: 'dither' in line['types'], c)
+
+        if dither and (self.jit or self.palette or self.overlay):
+            raise Exception(self.name + ': DITHER can not be used with ' +
+                            'JIT, PALETTE or OVERLAY')
+
+        return dither
+
+    def _feedback(self, c):
+        return filter(lambda line: 'feedback' in line['types'], c)
+
     def _max_fps(self, c):
         max_fps = filter(lambda line: 'max_fps' in line['types'], c)
 
@@ -250,6 +318,12 @@ def analyze(name, content):
         types = '(void|uint8_t|uint16_t|float|int|char|double)'
         patterns = (
             ('flip', '#\s*pragma\s+FLIP\s*'),
+            ('jit', '#\s*pragma\s+JIT\s*'),
+            ('palette', '#\s*pragma\s+PALETTE\s*'),
+            ('overlay', '#\s*pragma\s+OVERLAY\s*'),
+            ('tween', '#\s*pragma\s+TWEEN\s*'),
+            ('dither', '#\s*pragma\s+DITHER\s*'),
+            ('feedback', '#\s*pragma\s+FEEDBACK\s*'),
             ('dynamic_text', '#\s*pragma\s+DYNAMIC_TEXT\s*'),
             ('max_fps', '#\s*pragma\s+MAX_FPS\s+[0-9]+\s*'),
             ('init', 'void\s+init\s*[(]'),
@@ -277,7 +351,7 @@ def analyze(name, content):
             ret['types'].remove('assignment')
 
         # TODO: fix the regex, matches too much
-        if 'flip' in ret['types'] or 'max_fps' in ret['types'] or 'dynamic_text' in ret['types']:
+        if 'flip' in ret['types'] or 'jit' in ret['types'] or 'palette' in ret['types'] or 'overlay' in ret['types'] or 'tween' in ret['types'] or 'dither' in ret['types'] or 'feedback' in ret['types'] or 'max_fps' in ret['types'] or 'dynamic_text' in ret['types']:
             ret['types'].remove('assignment')
 
         # TODO: fix the regex, matches too much
@@ -303,6 +377,8 @@ def analyze(name, content):
                 block = parse_xy(name, content, ret, i)
             if 'XYZ(' in ret['content']:
                 block = parse_xyz(name, content, ret, i)
+            if 'CANVAS(' in ret['content']:
+                block = parse_canvas(name, content, ret, i)
         elif 'function' in ret['types']:
             if line.strip()[-1] == ';':
                 ret['types'].remove('function')
@@ -386,6 +462,19 @@ def xyz_definition(name, line):
     return ret
 
 
+def parse_canvas(name, lines, line, index):
+    return _parse(name, lines, line, index, canvas_definition)
+
+
+def canvas_definition(name, line):
+    ret = 'CANVAS(effect_' + name + ') '
+
+    if line['content'].strip()[-1] == '{':
+        ret += ' {\n}'
+
+    return ret
+
+
 def parse_function(name, lines, line, index):
     return _parse(name, lines, line, index, function_definition)
 
@@ -0,0 +1,339 @@
+#
+# Copyright 2012 Elovalo project group
+#
+# This file is part of Elovalo.
+#
+# Elovalo is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Elovalo is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Elovalo.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""Generates voxel addressing code for cube geometries. Every
+geometry gets its own set_led() and get_led() implementation which
+uses precomputed address tables instead of branching on voxel
+alignment."""
+
+import os
+from collections import namedtuple
+
+Geometry = namedtuple('Geometry', 'name x y z depth bytes_per_layer '
+                      'shift_register_bytes')
+
+# Supported geometries. The first one is the hardware geometry which
+# uses the hand-optimized implementation in effects/lib/utils.c or a
+# lookup table when built with VOXEL_LUT. Other ones are built as
+# exporter variants to keep them working.
+GEOMETRIES = [
+    Geometry('8x8x8', 8, 8, 8, 12, 96, 1),
+    Geometry('16x16x16', 16, 16, 16, 12, 384, 2),
+    Geometry('8bit', 8, 8, 8, 8, 64, 1),
+]
+
+HANDWRITTEN = GEOMETRIES[0]
+
+file_start = '''/* GENERATED FILE! DON'T MODIFY!!!
+ * Voxel addressing for supported geometries
+ */
+'''
+
+
+def defines(g):
+    "Preprocessor definitions which select the given geometry"
+    return ['LEDS_X=%d' % g.x, 'LEDS_Y=%d' % g.y, 'LEDS_Z=%d' % g.z,
+            'GS_DEPTH=%d' % g.depth,
+            'BYTES_PER_LAYER=%d' % g.bytes_per_layer,
+            'SHIFT_REGISTER_BYTES=%d' % g.shift_register_bytes]
+
+
+def condition(g):
+    return ('LEDS_X == %d && LEDS_Y == %d && LEDS_Z == %d && '
+            'GS_DEPTH == %d && BYTES_PER_LAYER == %d' %
+            (g.x, g.y, g.z, g.depth, g.bytes_per_layer))
+
+
+def suffix(g):
+    return '%d_%d_%d' % (g.x, g.y, g.depth)
+
+
+def generate(header, source):
+    parent_dir = os.path.split(header)[0]
+
+    if not os.path.exists(parent_dir):
+        os.mkdir(parent_dir)
+
+    with open(header, 'w') as t:
+        t.write(file_start)
+        t.write('\n#ifndef GEOMETRY_H\n#define GEOMETRY_H\n\n')
+        t.write('#include <stdint.h>\n')
+        t.write('#include "../common/env.h"\n\n')
+        t.write(chain(lambda g: Layout(g).declarations()))
+        t.write('\n#endif /* GEOMETRY_H */\n')
+
+    with open(source, 'w') as t:
+        t.write(file_start)
+        t.write('\n#include <stdint.h>\n')
+        t.write('#include "../common/assert.h"\n')
+        t.write('#include "../common/pgmspace.h"\n')
+        t.write('#include "../common/cube.h"\n')
+        t.write('#include "geometry.h"\n\n')
+        t.write('#define GS_MAX ((1UL << GS_DEPTH) - 1)\n\n')
+        t.write(chain(lambda g: Layout(g).definitions(), error=False))
+
+
+def chain(f, error=True):
+    "Wraps output of f for every geometry inside #if chain"
+    ret = []
+    for i, g in enumerate(GEOMETRIES):
+        ret.append(('#if ' if i == 0 else '#elif ') + condition(g))
+        ret.append(f(g))
+    if error:
+        ret.append('#else')
+        ret.append('#error "There is no set_led() implementation for this '
+                   'geometry. Add it to generators/geometry.py"')
+    ret.append('#endif')
+    return '\n'.join(ret) + '\n'
+
+
+def c_type(max_value):
+    for bits in (8, 16, 32):
+        if max_value < (1 << bits):
+            return 'uint%d_t' % bits
+    raise Exception('Value does not fit to 32 bits')
+
+
+def c_array(name, ctype, values):
+    return 'static const %s %s[] PROGMEM = {%s};\n' % (
+        ctype, name, ','.join(str(v) for v in values))
+
+
+def pgm_type(ctype):
+    return {'uint8_t': 'byte', 'uint16_t': 'word',
+            'uint32_t': 'dword'}[ctype]
+
+
+class Layout(object):
+    """Voxel layout of a geometry. Voxels are packed MSB first,
+    starting from voxel (0,0) of the layer. Every voxel is accessed
+    through a big endian window of 1-3 bytes."""
+
+    def __init__(self, g):
+        self.g = g
+
+        if g.depth > 16:
+            raise Exception('GS_DEPTH over 16 is not supported')
+        if g.x * g.y * g.depth > 8 * g.bytes_per_layer:
+            raise Exception('Geometry %s does not fit in BYTES_PER_LAYER'
+                            % g.name)
+
+        # Byte position and bit shift in layer for every voxel
+        pos = [[g.depth * (x + g.x * y) for x in range(g.x)]
+               for y in range(g.y)]
+        self.window = max((p % 8 + g.depth + 7) // 8
+                          for row in pos for p in row)
+        self.byte = [[p // 8 for p in row] for row in pos]
+        self.shift = [[8 * self.window - p % 8 - g.depth for p in row]
+                      for row in pos]
+
+        if self.byte[-1][-1] + self.window > g.bytes_per_layer:
+            raise Exception('Voxel window of %s overruns the buffer. '
+                            'Add padding to BYTES_PER_LAYER' % g.name)
+
+        # When rows start at byte boundary, shifts depend on x only
+        # and a table per X axis is enough
+        self.separable = (g.depth * g.x) % 8 == 0
+        self.constant_shift = len(set(s for r in self.shift for s in r)) == 1
+
+    def declarations(self):
+        g = self.g
+        s = suffix(g)
+        ret = []
+        if g == HANDWRITTEN:
+            ret.append('/* Using hand-optimized implementation in '
+                       'effects/lib/utils.c unless VOXEL_LUT is defined */')
+        ret.append('#define set_led(x,y,z,i) set_led_%s(x,y,z,i)' % s)
+        ret.append('#define get_led(x,y,z) get_led_%s(x,y,z)' % s)
+        ret.append('void set_led_%s(uint8_t x, uint8_t y, uint8_t z, '
+                   'uint16_t i);' % s)
+        ret.append('uint16_t get_led_%s(uint8_t x, uint8_t y, uint8_t z);'
+                   % s)
+        return '\n'.join(ret) + '\n'
+
+    def definitions(self):
+        if self.g == HANDWRITTEN:
+            return self.lut_definitions()
+
+        ret = [self.tables()]
+        ret.append(self.function('set', 'void', 'gs_buf_back', ', uint16_t i'))
+        ret.append(self.function('get', 'uint16_t', 'gs_buf_front', ''))
+        return '\n'.join(ret)
+
+    def lut_definitions(self):
+        """Table based alternative to the hand-optimized implementation,
+        selected with VOXEL_LUT. Every voxel of a layer has one table
+        entry holding its byte offset shifted left by one, the lowest
+        bit telling that the voxel starts from the middle of a
+        byte."""
+        g = self.g
+        if g.depth != 12 or max(b for r in self.byte for b in r) >= 128:
+            raise Exception('VOXEL_LUT supports only 12 bit voxels in '
+                            'layers smaller than 128 bytes')
+
+        addr = [b << 1 | (1 if sh == 0 else 0)
+                for br, sr in zip(self.byte, self.shift)
+                for b, sh in zip(br, sr)]
+
+        ret = ['#ifdef VOXEL_LUT']
+        ret.append(c_array('voxel_addr', 'uint8_t', addr))
+        s = suffix(g)
+        address = ['\tconst uint8_t a = pgm_get(voxel_addr[x + LEDS_X * y],byte);',
+                   '\t%suint8_t *p = %s + z * BYTES_PER_LAYER + (a >> 1);']
+        asserts = ['\tassert(x < LEDS_X);', '\tassert(y < LEDS_Y);',
+                   '\tassert(z < LEDS_Z);']
+
+        ret.append('void set_led_%s(uint8_t x, uint8_t y, uint8_t z, '
+                   'uint16_t i)' % s)
+        ret.append('{')
+        ret.extend(asserts)
+        ret.append('\tassert(i <= GS_MAX);')
+        ret.append('')
+        ret.append(address[0])
+        ret.append(address[1] % ('', 'gs_buf_back'))
+        ret.append('\tif (a & 1) {')
+        ret.append('\t\tp[0] = (p[0] & 0xf0) | (i >> 8);')
+        ret.append('\t\tp[1] = i;')
+        ret.append('\t} else {')
+        ret.append('\t\tp[0] = i >> 4;')
+        ret.append('\t\tp[1] = (p[1] & 0x0f) | (i << 4);')
+        ret.append('\t}')
+        ret.append('\tmark_dirty(gs_buf_back, z);')
+        ret.append('}')
+        ret.append('')
+        ret.append('uint16_t get_led_%s(uint8_t x, uint8_t y, uint8_t z)' % s)
+        ret.append('{')
+        ret.extend(asserts)
+        ret.append('')
+        ret.append(address[0])
+        ret.append(address[1] % ('const ', 'gs_buf_front'))
+        ret.append('\tif (a & 1) return (p[0] & 0x0f) << 8 | p[1];')
+        ret.append('\treturn p[0] << 4 | p[1] >> 4;')
+        ret.append('}')
+        ret.append('#endif')
+        return '\n'.join(ret) + '\n'
+
+    def offset(self, pgm):
+        "Byte offset of voxel inside a row or a layer"
+        if self.byte_type is None:
+            n = self.g.depth // 8
+            return 'x * %d' % n if n > 1 else 'x'
+        return pgm('voxel_byte', self.byte_type)
+
+    def whole_window(self, kind):
+        if kind == 'set':
+            ret = ['\tp[%d] = i%s;' % (i, ' >> %d' % (8 * (self.window - 1 - i))
+                                       if i < self.window - 1 else '')
+                   for i in range(self.window)]
+            ret.append('\tmark_dirty(gs_buf_back, z);')
+            return ret
+        if self.window == 1:
+            return ['\treturn p[0];']
+        return ['\treturn (uint16_t)p[0] << 8 | p[1];']
+
+    def tables(self):
+        g = self.g
+        self.byte_type = None
+
+        # Aligned voxels are addressed by plain multiplication
+        if self.separable and g.depth % 8 == 0:
+            return ''
+
+        if self.separable:
+            byte = self.byte[0]
+            shift = self.shift[0]
+        else:
+            byte = sum(self.byte, [])
+            shift = sum(self.shift, [])
+
+        ret = ''
+        self.byte_type = c_type(max(byte))
+        ret += c_array('voxel_byte', self.byte_type, byte)
+        if not self.constant_shift:
+            mul = [1 << v for v in shift]
+            self.mul_type = c_type(max(mul))
+            ret += c_array('voxel_mul', self.mul_type, mul)
+            ret += c_array('voxel_shift', 'uint8_t', shift)
+        return ret
+
+    def function(self, kind, ret_type, buf, extra_args):
+        g = self.g
+        window_type = c_type((1 << (8 * self.window)) - 1)
+        if self.separable:
+            index = 'x'
+            row = ' + y * %d' % (g.depth * g.x // 8)
+        else:
+            index = 'x + LEDS_X * y'
+            row = ''
+
+        def pgm(table, ctype):
+            return 'pgm_get(%s[%s],%s)' % (table, index, pgm_type(ctype))
+
+        lines = ['%s %s_led_%s(uint8_t x, uint8_t y, uint8_t z%s)' %
+                 (ret_type, kind, suffix(g), extra_args), '{']
+        lines.append('\tassert(x < LEDS_X);')
+        lines.append('\tassert(y < LEDS_Y);')
+        lines.append('\tassert(z < LEDS_Z);')
+        if kind == 'set':
+            lines.append('\tassert(i <= GS_MAX);')
+        lines.append('')
+        lines.append('\t%suint8_t *p = %s + z * BYTES_PER_LAYER%s + %s;' %
+                     ('const ' if kind == 'get' else '', buf, row,
+                      self.offset(pgm)))
+
+        # Voxel occupying its whole window needs no masking
+        if self.window * 8 == g.depth:
+            lines.extend(self.whole_window(kind))
+            lines.append('}')
+            return '\n'.join(lines) + '\n'
+
+        # Read the window
+        parts = ['(%s)p[%d] << %d' % (window_type, i,
+                                        8 * (self.window - 1 - i))
+                 for i in range(self.window)]
+        parts[-1] = 'p[%d]' % (self.window - 1)
+        lines.append('\t%s raw = %s;' % (window_type, ' | '.join(parts)))
+
+        if kind == 'set':
+            if self.constant_shift:
+                lines.append('\traw = (raw & ~((%s)GS_MAX << %d)) | '
+                             '((%s)i << %d);' % (window_type, self.shift[0][0],
+                                                 window_type, self.shift[0][0]))
+            else:
+                lines.append('\tconst %s mul = %s;' %
+                             (window_type, pgm('voxel_mul', self.mul_type)))
+                lines.append('')
+                lines.append('\t/* Multiplying by power of two puts the '
+                             'intensity in place without')
+                lines.append('\t * branching on voxel alignment. */')
+                lines.append('\traw = (raw & ~((%s)GS_MAX * mul)) | '
+                             '((%s)i * mul);' % (window_type, window_type))
+            for i in range(self.window):
+                shift = 8 * (self.window - 1 - i)
+                lines.append('\tp[%d] = raw%s;' %
+                             (i, ' >> %d' % shift if shift else ''))
+            lines.append('\tmark_dirty(gs_buf_back, z);')
+        else:
+            if self.constant_shift:
+                shift = str(self.shift[0][0])
+            else:
+                shift = pgm('voxel_shift', 'uint8_t')
+            lines.append('\treturn (raw >> %s) & GS_MAX;' % shift)
+        lines.append('}')
+        return '\n'.join(lines) + '\n'
@@ -18,6 +18,7 @@
 #
 
 import os
+import re
 import json
 import itertools
 import subprocess
@@ -26,6 +27,10 @@ import xml.etree.ElementTree as ET
 from glob import glob
 
 TICK_GRANULARITY = 0.008
+BLEND_MODES = ('add', 'max', 'multiply', 'alpha', 'mix')
+NO_OVERLAY = '255'
+TRANSITIONS = ('none', 'crossfade', 'wipe_x', 'wipe_y', 'wipe_z', 'dissolve')
+DEFAULT_TRANSITION_LENGTH = 1.0
 
 
 def generate(source, target, conf, effects=None):
@@ -34,8 +39,10 @@ def generate(source, target, conf, effects=None):
     if not os.path.exists(parent_dir):
         os.mkdir(parent_dir)
 
-    write(target, playlist_source(attach_ids(get_playlists(
-        load(source), load_conf(conf)), get_names(effects))))
+    data = get_playlists(load(source), load_conf(conf))
+    check_items(data, effects)
+
+    write(target, playlist_source(attach_ids(data, get_names(effects))))
 
 
 def load(source):
@@ -75,6 +82,63 @@ def get_playlists(data, conf):
     return data
 
 
+def check_items(data, effects):
+    paths = dict(zip(get_names(effects), effects))
+
+    def pragmas(name):
+        with open(paths[name], 'r') as f:
+            return re.findall(r'#\s*pragma\s+(\w+)', f.read())
+
+    # Playlists wrap around, so the first item follows the last
+    items = itertools.chain(*[zip(d['playlist'][-1:] + d['playlist'][:-1],
+                                  d['playlist']) for d in data])
+
+    for previous, effect in items:
+        name = effect['name']
+        base = pragmas(name)
+
+        if effect.get('transition', 'none') != 'none':
+            check_transition(effect, base, previous,
+                             pragmas(previous['name']))
+
+        if 'overlay' not in effect:
+            continue
+
+        if 'OVERLAY' not in pragmas(effect['overlay']):
+            raise Exception(effect['overlay'] + ': not an OVERLAY effect')
+        if 'FLIP' not in base and 'JIT' not in base:
+            raise Exception(name + ': overlay needs a flipping effect')
+        if 'PALETTE' in base or 'DITHER' in base or 'OVERLAY' in base:
+            raise Exception(name + ': can not have an overlay')
+        if 'FEEDBACK' in base:
+            raise Exception(name + ': reads its previous frame, which ' +
+                            'would contain the overlay')
+        if effect.get('blend', 'alpha') not in BLEND_MODES:
+            raise Exception(name + ': unknown blend mode ' +
+                            effect['blend'])
+        if not 0 <= effect.get('alpha', 255) <= 255:
+            raise Exception(name + ': alpha must be between 0 and 255')
+
+
+def check_transition(effect, base, previous, previous_base):
+    name = effect['name']
+
+    if effect['transition'] not in TRANSITIONS:
+        raise Exception(name + ': unknown transition ' + effect['transition'])
+    if 'FLIP' not in base and 'JIT' not in base:
+        raise Exception(name + ': transition needs a flipping effect')
+    if 'PALETTE' in base or 'DITHER' in base:
+        raise Exception(name + ': PALETTE and DITHER effects can not ' +
+                        'transition')
+    if 'FEEDBACK' in base:
+        raise Exception(name + ': FEEDBACK effects can not transition')
+    # JIT items without overlay or transition leave front stale
+    if ('JIT' in previous_base and 'overlay' not in previous and
+            previous.get('transition', 'none') == 'none'):
+        raise Exception(name + ': can not transition from JIT effect ' +
+                        previous['name'])
+
+
 def attach_ids(data, effects):
     for d in data:
         playlist = d['playlist']
@@ -82,6 +146,9 @@ def attach_ids(data, effects):
         for effect in playlist:
             effect['id'] = str(effects.index(effect['name']))
 
+            if 'overlay' in effect:
+                effect['overlay_id'] = str(effects.index(effect['overlay']))
+
     return data
 
 
@@ -106,6 +173,8 @@ def playlist_source(data):
 #include <stdlib.h>
 #include "../common/playlists.h"
 #include "../common/pgmspace.h"
+#include "../common/transition.h"
+#include "../effects/lib/blend.h"
 #include "../effects/lib/font8x8.h"
 '''
 
@@ -144,7 +213,13 @@ def playlist_source(data):
 
         [ret.append('\t{ ' + str(fx['id']) + ', ' + \
             str(int(fx['length'] / TICK_GRANULARITY)) + \
-            ', &s_playlist_item_' + str(i) + \
+            ', &s_playlist_item_' + str(i) + ', ' + \
+            fx.get('overlay_id', NO_OVERLAY) + ', ' + \
+            'BLEND_' + fx.get('blend', 'alpha').upper() + ', ' + \
+            str(fx.get('alpha', 255)) + ', ' + \
+            'TRANSITION_' + fx.get('transition', 'none').upper() + ', ' + \
+            str(int(fx.get('transition_length', DEFAULT_TRANSITION_LENGTH) /
+                TICK_GRANULARITY)) + \
             ' },') for i, fx in enumerate(effects)]
 
         ret.append('};')
@@ -189,11 +264,21 @@ def load_xml(src):
 
     for effect in root.getchildren():
         data = effect.findall('data')
-        ret.append({
+        item = {
             'name': effect.attrib['name'],
             'length': int(effect.findall('length')[0].text),
             'data': effect[0].text if len(data) else ''
-        })
+        }
+
+        # Optional overlay and transition of the effect
+        for tag, convert in (('overlay', str), ('blend', str),
+                ('alpha', int), ('transition', str),
+                ('transition_length', float)):
+            found = effect.findall(tag)
+            if found:
+                item[tag] = convert(found[0].text)
+
+        ret.append(item)
 
     return ret
 
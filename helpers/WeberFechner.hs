@@ -1,34 +1,43 @@
 -- |Implements Weber–Fechner law for per weight perception. Using S0
 -- of 1, k of 1. See more information:
 -- http://en.wikipedia.org/wiki/Weber%E2%80%93Fechner_law
-module WeberFechner (weberFechnerTable,cTable) where
+module WeberFechner (weberFechnerTable,fineTable,cTable) where
 
 import Data.List (intercalate)
 
 humanBits :: Integer
 pwmBits   :: Integer
+fineBits  :: Integer
 s0        :: Integer
 
 humanBits  = 8   -- ^Input value range
 pwmBits    = 12  -- ^Output value range
+fineBits   = 14  -- ^Output value range of the table used for dithering
 s0         = 10  -- ^Threshold of stimulus below which it is not perceived
 
-a = log(2^pwmBits-fromIntegral s0)/(2^humanBits-1)
-
 -- |Modified Weber–Fechner algorithm which saves energy when stimulus can not be
--- perceived.
-weberFechner :: Integer -> Integer
-weberFechner x_i | alg == s0 = 0
-                 | otherwise = alg
-  where alg = round (exp (a*x)) + (s0-1)
+-- perceived. The threshold is scaled to the output range.
+weberFechner :: Integer -> Integer -> Integer
+weberFechner bits x_i | alg == s = 0
+                      | otherwise = alg
+  where alg = round (exp (a*x)) + (s-1)
+        a = log(2^bits-fromIntegral s)/(2^humanBits-1)
+        s = s0 * 2^(bits-pwmBits)
         x = fromIntegral x_i
 
-weberFechnerTable = map weberFechner [0..2^humanBits-1]
+weberFechnerTable = map (weberFechner pwmBits) [0..2^humanBits-1]
+fineTable = map (weberFechner fineBits) [0..2^humanBits-1]
+
+header = "/* Pre-calculated Weber–Fechner tables generated by helpers/WeberFechner.hs */"
 
-header = "/* Pre-calculated Weber–Fechner table generated by helpers/WeberFechner.hs */"
-signature = "const uint16_t weber_fechner_table[] PROGMEM"
+table name xs = "const uint16_t " ++ name ++ "[] PROGMEM = {" ++ list ++ "};"
+  where list = intercalate "," $ map show xs
 
-cTable = header ++ "\n" ++ signature ++ " = {" ++ list ++ "};"
-  where list = intercalate "," $ map show weberFechnerTable
+cTable = intercalate "\n" [header
+                          ,table "weber_fechner_table" weberFechnerTable
+                          ,""
+                          ,"// Same curve in 14 bits for temporal dithering"
+                          ,table "weber_fechner_fine_table" fineTable
+                          ]
 
 main = putStrLn cTable
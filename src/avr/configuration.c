@@ -22,6 +22,8 @@
 #include "cron.h"
 #include "configuration.h"
 #include "powersave.h"
+#include "tlc5940.h"
+#include "../common/output.h"
 
 #define EVERY_DAY 0x7f
 #define END_OF_CRONTAB { .kind = END }
@@ -37,6 +39,11 @@ uint32_t EEMEM eeprom_timezone = 0; // UTC by default
 uint8_t EEMEM eeprom_effect = 0;
 uint8_t EEMEM eeprom_playlist = 0;
 uint8_t EEMEM eeprom_mode = MODE_SLEEP;
+uint8_t EEMEM eeprom_orientation = 0; // Identity
+uint8_t EEMEM eeprom_power_budget = POWER_UNLIMITED;
+uint8_t EEMEM eeprom_calibration[CHANNELS] = {
+	[0 ... CHANNELS-1] = CALIBRATION_FULL
+};
 
 void get_crontab_entry(struct event *p,uint8_t i)
 {
@@ -94,3 +101,33 @@ void store_mode(uint8_t m)
 {
 	eeprom_update_byte(&eeprom_mode,m);
 }
+
+uint8_t read_orientation(void)
+{
+	return eeprom_read_byte(&eeprom_orientation);
+}
+
+void store_orientation(uint8_t o)
+{
+	eeprom_update_byte(&eeprom_orientation,o);
+}
+
+void read_calibration(uint8_t *p)
+{
+	eeprom_read_block(p,eeprom_calibration,CHANNELS);
+}
+
+void store_calibration(const uint8_t *p)
+{
+	eeprom_update_block(p,eeprom_calibration,CHANNELS);
+}
+
+uint8_t read_power_budget(void)
+{
+	return eeprom_read_byte(&eeprom_power_budget);
+}
+
+void store_power_budget(uint8_t b)
+{
+	eeprom_update_byte(&eeprom_power_budget,b);
+}
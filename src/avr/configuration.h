@@ -74,3 +74,36 @@ uint8_t read_mode(void);
  * Store operating mode to persistent storage
  */
 void store_mode(uint8_t m);
+
+/**
+ * Read cube orientation from persistent storage. See output.h for
+ * the values.
+ */
+uint8_t read_orientation(void);
+
+/**
+ * Store cube orientation to persistent storage
+ */
+void store_orientation(uint8_t o);
+
+/**
+ * Read channel calibration table of CHANNELS bytes from persistent
+ * storage. See output.h for the values.
+ */
+void read_calibration(uint8_t *p);
+
+/**
+ * Store channel calibration table to persistent storage
+ */
+void store_calibration(const uint8_t *p);
+
+/**
+ * Read power budget from persistent storage. See tlc5940.h for the
+ * values.
+ */
+uint8_t read_power_budget(void);
+
+/**
+ * Store power budget to persistent storage
+ */
+void store_power_budget(uint8_t b);
@@ -20,7 +20,9 @@
 #include <avr/interrupt.h>
 #include <avr/wdt.h>
 #include <avr/io.h>
+#include <util/atomic.h>
 #include <stdlib.h>
+#include <string.h>
 #include "pinMacros.h"
 #include "init.h"
 #include "tlc5940.h"
@@ -34,13 +36,31 @@
 #include "zcl_skeleton.h"
 #include "../common/pgmspace.h"
 #include "../common/cube.h"
+#include "../common/output.h"
+#include "../common/transition.h"
 #include "../common/effects.h"
+#include "../effects/lib/blend.h"
 #include "../common/playlists.h"
 
 uint8_t mode = MODE_IDLE; // Starting with no operation on.
 const effect_t *effect; // Current effect. Note: points to PGM
 
 uint16_t effect_length; // Length of the current effect. Used for playlist
+
+// Effect drawn on top of the current one. Used for playlist
+static struct {
+	const effect_t *effect; // Points to PGM, NULL if none
+	uint8_t blend;
+	uint8_t alpha;
+} overlay;
+
+// Transition into the current playlist item
+static struct {
+	uint8_t type;
+	uint16_t length;
+} item_transition;
+static bool fade_in; // Next initialization continues a playlist
+
 static uint16_t next_draw_at = 0; // Used for FPS limiting
 
 // It might be nice to use this for single effect too (set via serial).
@@ -51,6 +71,22 @@ uint8_t active_playlist; // Index of the active playlist
 #ifdef SIMU
 uint8_t simulation_mode __attribute__ ((section (".noinit")));
 uint8_t simulation_effect __attribute__ ((section (".noinit")));
+
+// Simulation mode for measuring cycle counts instead of drawing
+#define SIMULATION_CYCLES 0x10
+
+/* CPU cycles taken by writing and reading every voxel once,
+ * including the loops. Compare builds with and without
+ * --voxel-lut. Expanding is the work the multiplexer does for
+ * every layer of a dithered frame in each refresh. */
+struct {
+	uint32_t set_led;
+	uint32_t get_led;
+	uint16_t sum; // Keeps reads from being optimized out
+	uint32_t expand_levels;
+} simulation_cycles __attribute__ ((section (".noinit")));
+
+static void measure_cycles(void);
 #endif
 
 struct {
@@ -63,6 +99,7 @@ struct {
 // Private functions
 static void init_playlist(void);
 static void next_effect();
+static void draw_overlay(void);
 static void pick_startup_mode(void);
 
 int main() {
@@ -77,6 +114,17 @@ int main() {
 	init_effect_timer();
 	
 	init_playlist();
+
+	// Invalid value, like erased EEPROM, keeps the identity
+	set_orientation(read_orientation());
+	read_calibration(calibration);
+	update_calibration();
+	power_budget = read_power_budget();
+	tlc5940_update_power();
+
+#ifdef SIMU
+	if (simulation_mode == SIMULATION_CYCLES) measure_cycles();
+#endif
 	
 	initUSART();
 	sei();
@@ -105,14 +153,16 @@ int main() {
 			ticks = centisecs();
 			if (ticks > effect_length) {
 				next_effect();
+				fade_in = true;
 				init_current_effect();
 			}
 
 			// no need to break!
 			// fall to MODE_EFFECT on purpose
 		case MODE_EFFECT:
-			// If a buffer is not yet flipped, wait interrupts
-			if (flags.may_flip) {
+			/* If a buffer is not yet flipped, wait interrupts.
+			 * A third buffer is free for drawing meanwhile. */
+			if (flags.may_flip && !triple_active) {
 				sleep_if_no_traffic();
 				break;
 			}
@@ -145,12 +195,23 @@ int main() {
 			// Do the actual drawing
 			draw_t draw = (draw_t)pgm_get(effect->draw,word);
 			if (draw != NULL) {
+				// Back buffer may be still tweened from
+				ATOMIC_BLOCK(ATOMIC_FORCEON) {
+					tween_end();
+				}
 				draw();
-				allow_flipping(true);
+				if (overlay.effect != NULL) draw_overlay();
+				if (transition_active) transition_apply(ticks);
+				frame_stats.draws++;
+				// JIT layers are shown as soon as rendered
+				if (!jit_active) allow_flipping(true);
 			}
 
-			// Update time when next drawing is allowed
-			next_draw_at = ticks + pgm_get(effect->minimum_ticks,byte);
+			/* Update time when next drawing is allowed. JIT
+			 * effects are redrawn on every frame. */
+			if (!jit_active) {
+				next_draw_at = ticks + pgm_get(effect->minimum_ticks,byte);
+			}
 
 			break;
 		}
@@ -160,6 +221,57 @@ int main() {
 }
 
 #if defined SIMU
+/* Runs with interrupts disabled before sensors take Timer1 in
+ * use. Simulation is stopped when the results are ready. */
+static void measure_cycles(void)
+{
+	simulation_cycles.set_led = 0;
+	simulation_cycles.get_led = 0;
+	simulation_cycles.sum = 0;
+	simulation_cycles.expand_levels = 0;
+
+	// Timer1 counts CPU cycles. One layer at a time fits 16 bits.
+	TCCR1A = 0;
+	TCCR1B = 1 << CS10;
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		uint16_t start = TCNT1;
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			for (uint8_t x = 0; x < LEDS_X; x++) {
+				set_led(x, y, z, x << 8 | y << 4 | z);
+			}
+		}
+		simulation_cycles.set_led += (uint16_t)(TCNT1 - start);
+
+		start = TCNT1;
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			for (uint8_t x = 0; x < LEDS_X; x++) {
+				simulation_cycles.sum += get_led(x, y, z);
+			}
+		}
+		simulation_cycles.get_led += (uint16_t)(TCNT1 - start);
+	}
+
+	// Levels of all intensities, expanded as by the multiplexer
+	uint8_t out[BYTES_PER_LAYER];
+	gs_buf_set_format(gs_buf_back, OUTPUT_LEVEL);
+	for (uint16_t i = 0; i < LEDS_Z * LEVEL_BYTES_PER_LAYER; i++) {
+		gs_buf_back[i] = i;
+	}
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		uint16_t start = TCNT1;
+		output_layer(gs_buf_back, z, out);
+		simulation_cycles.expand_levels += (uint16_t)(TCNT1 - start);
+		simulation_cycles.sum += out[z];
+	}
+
+	// Leave Timer1 in reset state for hcsr04
+	TCCR1B = 0;
+	TCNT1 = 0;
+
+	asm volatile("break");
+}
+
 static void pick_startup_mode(void)
 {
 	// Start normally
@@ -229,29 +341,96 @@ void select_playlist_item(uint8_t index) {
 	effect = effects + e_id;
 	effect_length = pgm_get(item->length,word);
 	custom_data = (void*)pgm_get(item->data,word);
+
+	const uint8_t o_id = pgm_get(item->overlay,byte);
+	overlay.effect = o_id == NO_OVERLAY ? NULL : effects + o_id;
+	overlay.blend = pgm_get(item->blend,byte);
+	overlay.alpha = pgm_get(item->alpha,byte);
+
+	item_transition.type = pgm_get(item->transition,byte);
+	item_transition.length = pgm_get(item->transition_length,word);
+}
+
+/* Draws the overlay on top of the frame just drawn. Layer stages of
+ * the overlay composite their layers instead of overwriting. */
+static void draw_overlay(void) {
+	draw_t draw = (draw_t)pgm_get(overlay.effect->draw, word);
+	if (draw == NULL) return;
+
+	blend_mode = overlay.blend;
+	blend_alpha = overlay.alpha;
+	draw();
+	blend_mode = BLEND_NONE;
 }
 
 void init_current_effect(void) {
+	// JIT slots bypass front, leaving an old frame there
+	const bool stale = jit_active;
+
 	// Disable flipping until first frame is drawn
 	allow_flipping(false);
+	allow_jit(false);
+	allow_tween(false);
 
 	/* Restore front and back buffer pointers to point to
 	 * different locations */
-	gs_restore_bufs();
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		gs_restore_bufs();
+	}
+
+	/* Palette and dithered effects draw indices and levels. The
+	 * buffer formats change while not in front, the rest follow
+	 * after swap. */
+	const uint8_t format = pgm_get(effect->palette, byte) ?
+		OUTPUT_PALETTE : pgm_get(effect->dither, byte) ?
+		OUTPUT_LEVEL : OUTPUT_DIRECT;
+	if (format == OUTPUT_PALETTE) memset(palette, 0, sizeof(palette));
+	gs_buf_set_format(gs_buf_back, format);
+
+	/* Playlist items may fade in from the outgoing frame, which
+	 * then stays in front until the transition is over. Feedback
+	 * effects would read the mix, so they cut like after JIT. */
+	const uint8_t flip = pgm_get(effect->flip_buffers, byte);
+	const bool cut = flip == NO_FLIP || stale ||
+		pgm_get(effect->feedback, byte);
+	const bool fade = transition_start(
+		fade_in && !cut ? item_transition.type : TRANSITION_NONE,
+		item_transition.length);
+	fade_in = false;
 
 	// Set up rng
 	srand_from_clock();
 
-	// Run initializer
+	// Run initializers, overlay first to keep the effect drawn
+	if (overlay.effect != NULL) {
+		init_t init = (init_t)pgm_get(overlay.effect->init, word);
+		if (init != NULL) init();
+	}
 	init_t init = (init_t)pgm_get(effect->init, word);
 	if (init != NULL) init();
-	gs_buf_swap();
+	if (!fade) gs_buf_swap();
+	gs_buf_set_format(gs_buf_back, format);
+#ifdef TRIPLE_BUFFER
+	// Palette frames are small enough for a third buffer
+	if (flip == FLIP && format == OUTPUT_PALETTE) gs_buf_triple();
+#endif
 	
 	/* If NO_FLIP, we "broke" flipping if required by pointing
 	 * both buffers to the same location */
-	if (pgm_get(effect->flip_buffers, byte) == NO_FLIP) {
+	if (flip == NO_FLIP) {
 		gs_buf_back = gs_buf_front;
+	} else if (flip == JIT && JIT_SUPPORTED && !orientation &&
+		   !calibrated && overlay.effect == NULL && !fade) {
+		/* Slots are rendered over the back buffer. They bypass
+		 * the output stage, and overlays and transitions need
+		 * the whole frame, so those cases flip. */
+		gs_buf_dirty(gs_buf_back) = ALL_LAYERS;
+		allow_jit(true);
 	}
+
+	// Slow effects may be interpolated between flipped frames
+	allow_tween(pgm_get(effect->tween, byte) && flip == FLIP &&
+		    !jit_active);
 	
 	// Restart tick counter and FPS limiter
 	reset_time();
@@ -265,6 +444,7 @@ uint8_t change_current_effect(uint8_t i) {
 	mode = MODE_EFFECT;
 	effect = effects + i;
 	custom_data = NULL; // Used in playlists only
+	overlay.effect = NULL;
 
 	// Prepare running of the new effect
 	init_current_effect();
@@ -287,6 +467,7 @@ void use_stored_effect(void)
 
 	effect = effects + new_effect;
 	custom_data = NULL; // Used in playlists only
+	overlay.effect = NULL;
 	init_current_effect();
 }
 
@@ -318,6 +499,39 @@ uint8_t change_playlist(uint8_t i) {
 	return 0;
 }
 
+uint8_t change_orientation(uint8_t o) {
+	// Multiplexer reads the mapping while expanding
+	bool ok;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		ok = set_orientation(o);
+	}
+	if (!ok) return 1;
+	store_orientation(o);
+
+	// Reinitialize to choose between JIT and flipping again
+	if (jit_active) init_current_effect();
+
+	return 0;
+}
+
+void change_calibration(const uint8_t *p, uint16_t first, uint16_t n) {
+	// Multiplexer reads the table while expanding
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		memcpy(calibration + first, p, n);
+		update_calibration();
+	}
+	store_calibration(calibration);
+
+	// Reinitialize to choose between JIT and flipping again
+	if (jit_active) init_current_effect();
+}
+
+void change_power_budget(uint8_t b) {
+	power_budget = b;
+	tlc5940_update_power();
+	store_power_budget(b);
+}
+
 uint8_t get_mode(void) {
 	return mode;
 }
@@ -31,6 +31,9 @@ void select_playlist_item(uint8_t index);
 void init_current_effect(void);
 uint8_t change_current_effect(uint8_t i);
 uint8_t change_playlist(uint8_t i);
+uint8_t change_orientation(uint8_t o);
+void change_calibration(const uint8_t *p, uint16_t first, uint16_t n);
+void change_power_budget(uint8_t b);
 
 void use_stored_effect(void);
 void use_stored_playlist(void);
@@ -20,36 +20,97 @@
 /* Functions for USART access */
 
 #include "sleep.h"
+#include <stdbool.h>
+#include <string.h>
 #include <util/atomic.h>
+#include <avr/pgmspace.h>
 #include "serial.h"
+#include "serial_escaped.h"
 
 // TX ring buffer
 static uint8_t tx_buf[TX_BUF_SIZE];
 static uint8_t tx_in_i = 0;
-volatile static uint8_t tx_out_i = 0; // Set by USART_TX_vect
+volatile static uint8_t tx_out_i = 0; // Set by USART_UDRE_vect
+
+/* Queue of blocks to send. Single bytes are stored in the ring
+ * buffer and queued as TX_RING blocks, which keeps them in order with
+ * the other blocks. The block being sent is consumed in place. */
+struct tx_block {
+	const uint8_t *p;
+	uint16_t len;
+	uint8_t mode;
+};
+
+static struct tx_block tx_queue[TX_QUEUE_LEN];
+static uint8_t txq_in_i = 0;
+volatile static uint8_t txq_out_i = 0; // Set by USART_UDRE_vect
+
+// Second character of an escaped or hex encoded byte
+static uint8_t tx_second;
+static bool tx_second_pending = false;
 
 // Transmitter state
 volatile uint8_t tx_state = TXRX_OK;
 
+static uint8_t hex_digit(uint8_t x)
+{
+	return x < 10 ? '0' + x : 'A' + x - 10;
+}
+
 /**
- * Called when USART has finished transmit.
+ * Called when USART is ready to take the next byte. Disabled when
+ * there is nothing to send.
  */
-ISR(USART_TX_vect)
+ISR(USART_UDRE_vect)
 {
-	// If no data in buffer, then we just bail out.
-	if (tx_in_i == tx_out_i) return;
+	if (tx_second_pending) {
+		UDR0 = tx_second;
+		tx_second_pending = false;
+		return;
+	}
 
 	// If it overflows, do not fill console with garbage.
-	if (tx_state == TXRX_OVERFLOW) return;
+	if (txq_in_i == txq_out_i || tx_state == TXRX_OVERFLOW) {
+		UCSR0B &= ~(1<<UDRIE0);
+		return;
+	}
 
-	// Send the byte and wrap to start if needed
-	UDR0 = tx_buf[tx_out_i++];
-	if (tx_out_i == TX_BUF_SIZE) tx_out_i = 0;
+	struct tx_block *b = tx_queue + txq_out_i;
+	uint8_t x;
+	if (b->mode & TX_RING) {
+		x = tx_buf[tx_out_i++];
+		if (tx_out_i == TX_BUF_SIZE) tx_out_i = 0;
+	} else if (b->mode & TX_PGM) {
+		x = pgm_read_byte(b->p++);
+	} else {
+		x = *b->p++;
+	}
+
+	if (b->mode & TX_HEX) {
+		UDR0 = hex_digit(x >> 4);
+		tx_second = hex_digit(x & 0x0f);
+		tx_second_pending = true;
+	} else {
+		UDR0 = x;
+		if ((b->mode & TX_ESCAPE) && x == ESCAPE) {
+			tx_second = LITERAL_ESCAPE;
+			tx_second_pending = true;
+		}
+	}
+
+	if (--b->len == 0) {
+		txq_out_i++;
+		if (txq_out_i == TX_QUEUE_LEN) txq_out_i = 0;
+	}
 }
 
 void serial_TX_empty(void) {
-	tx_in_i = tx_out_i;
-	tx_state = TXRX_OK;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		tx_in_i = tx_out_i;
+		txq_in_i = txq_out_i;
+		tx_second_pending = false;
+		tx_state = TXRX_OK;
+	}
 }
 
 uint8_t serial_send_available(void) {
@@ -57,33 +118,89 @@ uint8_t serial_send_available(void) {
 	return (tx_out_i < tx_in_i + 1) ? diff + TX_BUF_SIZE : diff;
 }
 
-void serial_send_nonblocking(uint8_t data)
+static bool queue_full(void)
 {
-	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	uint8_t next = txq_in_i + 1;
+	if (next == TX_QUEUE_LEN) next = 0;
+	return next == txq_out_i;
+}
 
-		/* If buffer is empty and no byte is in transit, do not queue
-		 * at all. */
-		if (tx_in_i == tx_out_i && (UCSR0A & (1<<UDRE0))) {
-			UDR0 = data;
-			return;
-		}
+/**
+ * Returns the last queued block if bytes may still be appended to
+ * it, otherwise NULL. Call with interrupts disabled.
+ */
+static struct tx_block *ring_block(void)
+{
+	if (txq_in_i == txq_out_i) return NULL;
+
+	uint8_t last = (txq_in_i == 0 ? TX_QUEUE_LEN : txq_in_i) - 1;
+	return tx_queue[last].mode & TX_RING ? tx_queue + last : NULL;
+}
 
-		tx_buf[tx_in_i++] = data;
+/**
+ * Queues a block. Call with interrupts disabled and check that the
+ * queue is not full.
+ */
+static void enqueue(const void *p, uint16_t len, uint8_t mode)
+{
+	tx_queue[txq_in_i] = (struct tx_block){p, len, mode};
+	txq_in_i++;
+	if (txq_in_i == TX_QUEUE_LEN) txq_in_i = 0;
+	UCSR0B |= (1<<UDRIE0);
+}
 
-		// Wrap to start
-		if (tx_in_i == TX_BUF_SIZE) tx_in_i = 0;
+/**
+ * Appends a byte to the ring buffer unless the ring or the queue is
+ * full. Call with interrupts disabled.
+ */
+static bool ring_put(uint8_t data)
+{
+	if (serial_send_available() == 0) return false;
 
-		if (tx_in_i == tx_out_i) {
-			// Overflow condition
-			tx_state = TXRX_OVERFLOW;
-		}
+	struct tx_block *b = ring_block();
+	if (b == NULL && queue_full()) return false;
+
+	tx_buf[tx_in_i++] = data;
+
+	// Wrap to start
+	if (tx_in_i == TX_BUF_SIZE) tx_in_i = 0;
+
+	if (b == NULL) enqueue(NULL, 1, TX_RING);
+	else b->len++;
+	return true;
+}
+
+void serial_send_nonblocking(uint8_t data)
+{
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		// Overflow condition
+		if (!ring_put(data)) tx_state = TXRX_OVERFLOW;
 	}
 }
 
 void serial_send(uint8_t data) {
-	while ((tx_in_i+1 == tx_out_i) ||
-		   (tx_in_i == TX_BUF_SIZE-1 && tx_out_i == 0));
-	serial_send_nonblocking(data);
+	bool sent = false;
+	while (!sent) {
+		ATOMIC_BLOCK(ATOMIC_FORCEON) {
+			sent = ring_put(data);
+		}
+	}
+}
+
+void serial_send_block(const void *p, uint16_t len, uint8_t mode)
+{
+	if (len == 0) return;
+	while (queue_full());
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		enqueue(p, len, mode);
+	}
+}
+
+void serial_sync(void)
+{
+	while (txq_in_i != txq_out_i && tx_state == TXRX_OK) {
+		sleep_mode();
+	}
 }
 
 /* Receiver functions. Conditionally compiled only for elocmd
@@ -154,4 +271,34 @@ uint8_t serial_read_blocking(void) {
 	return serial_read();
 }
 
+uint16_t serial_read_block(uint8_t *dest, uint16_t n)
+{
+	uint16_t i = 0;
+	while (i < n) {
+		while(!serial_available()) {
+			sleep_mode();
+		}
+
+		// Copy the contiguous part of the ring at once
+		uint16_t len = serial_available();
+		if (len > RX_BUF_SIZE - rx_out_i) len = RX_BUF_SIZE - rx_out_i;
+		if (len > n - i) len = n - i;
+
+		const uint8_t *src = rx_buf + rx_out_i;
+		const uint8_t *zero = memchr(src, 0, len);
+		if (zero != NULL) len = zero - src;
+
+		memcpy(dest + i, src, len);
+		i += len;
+		rx_out_i += len;
+		if (rx_out_i == RX_BUF_SIZE) rx_out_i = 0;
+
+		if (zero != NULL) {
+			serial_read(); // Consume the zero
+			break;
+		}
+	}
+	return i;
+}
+
 #endif // AVR_ELO
@@ -26,6 +26,7 @@
 #include <stdint.h>
 
 #define TX_BUF_SIZE 16
+#define TX_QUEUE_LEN 8
 #define RX_BUF_SIZE 64
 #define TXRX_OK 0
 #define TXRX_OVERFLOW 1
@@ -71,18 +72,48 @@ void serial_ungetc(uint8_t x);
 uint8_t serial_send_available(void);
 
 /**
- * Send a byte to serial port. Does not check overflow condition; the
- * user is responsible to check serial_send_available() before calling
+ * Send a byte to serial port. If there is no room, the byte is
+ * dropped and tx_state is set to TXRX_OVERFLOW; the user is
+ * responsible to check serial_send_available() before calling
  * this. Do not use from interrupts (or manipulate atomic block)
  */
 void serial_send_nonblocking(uint8_t data);
 
+// Modes of serial_send_block(), may be combined
+#define TX_SRAM   0x00 // Block is in SRAM
+#define TX_PGM    0x01 // Block is in program memory
+#define TX_ESCAPE 0x02 // Escape characters are escaped like in Elo
+#define TX_HEX    0x04 // Bytes are sent as two uppercase hex digits
+#define TX_RING   0x08 // Internal: bytes are in the ring buffer
+
+/**
+ * Queues len bytes at p to be sent by the interrupt handler in the
+ * given mode, without copying. Blocks only if there are already
+ * TX_QUEUE_LEN blocks in the queue. The data must stay untouched
+ * until it is sent, so use serial_sync() before letting SRAM data go
+ * out of scope. Do not call from interrupts!
+ */
+void serial_send_block(const void *p, uint16_t len, uint8_t mode);
+
+/**
+ * Waits until all queued bytes and blocks have been handed to USART.
+ */
+void serial_sync(void);
+
 /**
  * Reads a byte from receive buffer. Waits in a busy wait loop for
  * more data if no data is already available.
  */
 uint8_t serial_read_blocking(void);
 
+/**
+ * Reads n bytes from receive buffer to dest, copying as much at once
+ * as there is available. Waits for more data like
+ * serial_read_blocking(). Stops at a zero byte, which is consumed but
+ * not copied. Returns the number of bytes copied.
+ */
+uint16_t serial_read_block(uint8_t *dest, uint16_t n);
+
 /**
  * Send a byte to serial port. Checks overflow condition and blocks if
  * the buffer is full. Do not call from interrupts!
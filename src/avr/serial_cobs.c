@@ -0,0 +1,108 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef AVR_ELO
+
+#include <stdbool.h>
+#include <util/crc16.h>
+#include "serial.h"
+#include "serial_cobs.h"
+
+// Packet being decoded
+static uint8_t *payload;
+static uint16_t payload_len;
+static uint16_t pos; // Position in decoded packet
+static uint8_t header[2];
+static uint8_t trailer[2];
+
+/**
+ * Stores a decoded byte to its place in the packet. Bytes past the
+ * end are counted but dropped.
+ */
+static void put(uint8_t byte)
+{
+	if (pos < sizeof(header)) {
+		header[pos] = byte;
+	} else if (pos - sizeof(header) < payload_len) {
+		payload[pos - sizeof(header)] = byte;
+	} else if (pos - sizeof(header) - payload_len < sizeof(trailer)) {
+		trailer[pos - sizeof(header) - payload_len] = byte;
+	}
+	pos++;
+}
+
+/**
+ * Decodes n bytes which contain no zeros. Payload is copied straight
+ * from the receive buffer. Returns false if the packet ended early.
+ */
+static bool put_run(uint8_t n)
+{
+	while (n) {
+		if (pos >= sizeof(header) &&
+		    pos - sizeof(header) < payload_len) {
+			uint16_t len = payload_len - (pos - sizeof(header));
+			if (len > n) len = n;
+
+			uint16_t got = serial_read_block(
+				payload + pos - sizeof(header), len);
+			pos += got;
+			n -= got;
+			if (got < len) return false;
+		} else {
+			uint8_t byte = serial_read_blocking();
+			if (byte == 0) return false;
+			put(byte);
+			n--;
+		}
+	}
+	return true;
+}
+
+uint8_t cobs_to_sram(void *dest, uint16_t n)
+{
+	payload = dest;
+	payload_len = n;
+	pos = 0;
+
+	uint8_t code = serial_read_blocking();
+	if (code == 0) return COBS_END;
+
+	// Zero ends a group of less than 254 bytes unless it's the last
+	bool zero = false;
+	do {
+		if (zero) put(0);
+		if (!put_run(code - 1)) return COBS_BAD;
+		zero = code != 0xff;
+		code = serial_read_blocking();
+	} while (code != 0);
+
+	if (pos != sizeof(header) + n + sizeof(trailer)) return COBS_BAD;
+	if ((header[0] | (uint16_t)header[1] << 8) != n) return COBS_BAD;
+
+	uint16_t crc = 0xffff;
+	for (uint8_t i = 0; i < sizeof(header); i++)
+		crc = _crc_xmodem_update(crc, header[i]);
+	for (uint16_t i = 0; i < n; i++)
+		crc = _crc_xmodem_update(crc, payload[i]);
+
+	if ((trailer[0] | (uint16_t)trailer[1] << 8) != crc) return COBS_BAD;
+	return COBS_OK;
+}
+
+#endif // AVR_ELO
@@ -0,0 +1,47 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * COBS framed packets. Payload bytes are sent as they are, so there
+ * is no escaping and the overhead is at most one byte per 254. A
+ * packet consists of payload length (uint16_t), payload and CRC-16
+ * (uint16_t) of the length and the payload, computed like in ZCL.
+ * It is encoded with Consistent Overhead Byte Stuffing and ended
+ * with a zero byte. An empty packet, a lone zero byte, ends the
+ * transfer.
+ */
+
+#ifndef SERIAL_COBS_H_
+#define SERIAL_COBS_H_
+
+#include <stdint.h>
+
+#define COBS_OK  0 // Packet received
+#define COBS_END 1 // Empty packet received
+#define COBS_BAD 2 // Packet was damaged or of wrong length
+
+/**
+ * Receives a packet of n payload bytes to dest. Returns one of the
+ * values above. The contents of dest are undefined unless COBS_OK is
+ * returned. After a damaged packet the reading continues from the
+ * next one.
+ */
+uint8_t cobs_to_sram(void *dest, uint16_t n);
+
+#endif /* SERIAL_COBS_H_ */
@@ -26,22 +26,32 @@
 
 #include <avr/io.h>
 #include <avr/sleep.h>
+#include <util/atomic.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "main.h"
 #include "configuration.h"
 #include "serial.h"
 #include "serial_escaped.h"
+#include "serial_cobs.h"
 #include "../common/pgmspace.h"
 #include "serial_elo.h"
 #include "tlc5940.h" // Frame uploading needs this
 #include "../common/cube.h"
+#include "../common/output.h"
+#include "../effects/lib/utils.h"
 
 // Commands issued by the sender
 #define CMD_STOP            '.'
 #define CMD_LIST_EFFECTS    'e'
 #define CMD_CHANGE_EFFECT   'E'
 #define CMD_SERIAL_FRAME    'F'
+#define CMD_DELTA_FRAME     'D'
+#define CMD_PACKET_FRAME    'K'
+#define CMD_WRITE_LAYERS    'L'
+#define CMD_WRITE_BOX       'V'
+#define CMD_COMMIT_FRAME    'M'
 #define CMD_GET_TIME        't'
 #define CMD_SET_TIME        'T'
 #define CMD_SET_SENSOR      'S'
@@ -50,6 +60,13 @@
 #define CMD_READ_CRONTAB    'c'
 #define CMD_WRITE_CRONTAB   'C'
 #define CMD_SELECT_PLAYLIST 'P'
+#define CMD_GET_STATS       's'
+#define CMD_GET_ORIENTATION 'o'
+#define CMD_SET_ORIENTATION 'O'
+#define CMD_GET_CALIBRATION 'g'
+#define CMD_SET_CALIBRATION 'G'
+#define CMD_GET_POWER       'w'
+#define CMD_SET_POWER       'W'
 #define CMD_NOTHING         '*' // May be used to end binary transmission
 
 // Autonomous responses. These may occur anywhere, anytime
@@ -59,6 +76,8 @@
 #define REPORT_READY       ')' // Processing of command is ready
 #define REPORT_BOOT        'B' // Device has been (re)booted
 #define REPORT_FLIP        '%' // Frame has been flipped, ready to receive new
+#define REPORT_CREDIT      '+' // Followed by byte count of next frame to send
+#define REPORT_BAD_PACKET  '!' // Damaged packet was dropped
 
 // Typical answers to commands. Use of these is command-specific
 
@@ -76,6 +95,12 @@
 
 static void report(uint8_t code);
 static uint8_t answering(void);
+static void grant_credit(void);
+static void begin_partial(void);
+static void drop_third_buffer(void);
+
+// True when the back buffer has partial updates waiting for commit
+static bool partial = false;
 
 /**
  * Reports that the device has booted,
@@ -98,6 +123,9 @@ void serial_elo_process(uint8_t cmd) {
 
 	cmd = serial_read_blocking();
 
+	// Effects may have drawn over partial updates meanwhile
+	if (mode != MODE_IDLE) partial = false;
+
 	if (cmd == ESCAPE) {
 		// Put the character back
 		serial_ungetc(ESCAPE);
@@ -145,6 +173,35 @@ void serial_elo_process(uint8_t cmd) {
 		void *p = &sensors;
 		if (serial_to_sram(p+data.start,data.len) < data.len)
 			goto interrupted;
+	} ELSEIFCMD(CMD_GET_STATS) {
+		// Counters since the previous query
+		struct frame_stats s;
+		take_frame_stats(&s);
+		sram_to_serial(&s,sizeof(s));
+	} ELSEIFCMD(CMD_GET_ORIENTATION) {
+		send_escaped(orientation);
+	} ELSEIFCMD(CMD_SET_ORIENTATION) {
+		uint8_t o;
+		SERIAL_READ(o);
+		if ( change_orientation(o) ) {
+			goto bad_arg_a;
+		}
+	} ELSEIFCMD(CMD_GET_CALIBRATION) {
+		sram_to_serial(calibration,CHANNELS);
+	} ELSEIFCMD(CMD_SET_CALIBRATION) {
+		// Whole table is needed, partial one is thrown away
+		uint8_t table[CHANNELS];
+		if (serial_to_sram(table,CHANNELS) < CHANNELS)
+			goto interrupted;
+		change_calibration(table, 0, CHANNELS);
+	} ELSEIFCMD(CMD_GET_POWER) {
+		// Load of the shown frame and the budget
+		send_escaped(frame_load);
+		send_escaped(power_budget);
+	} ELSEIFCMD(CMD_SET_POWER) {
+		uint8_t b;
+		SERIAL_READ(b);
+		change_power_budget(b);
 	} ELSEIFCMD(CMD_LIST_EFFECTS) {
 		// Print effect names separated by '\0' character
 		for (uint8_t i=0; i<effects_len; i++) {
@@ -218,6 +275,12 @@ void serial_elo_process(uint8_t cmd) {
 		 * entries. */
 		truncate_crontab(i);
 	} ELSEIFCMD(CMD_SERIAL_FRAME) {
+		// Frames are uploaded to the back buffer as a whole
+		partial = false;
+		allow_jit(false);
+		allow_tween(false);
+		drop_third_buffer();
+
 		// Start by sending frame byte count
 		send_escaped(GS_BUF_BYTES >> 8);
 		send_escaped(GS_BUF_BYTES & 0xff);
@@ -228,10 +291,12 @@ void serial_elo_process(uint8_t cmd) {
 			while (flags.may_flip) {
 				sleep_mode();
 			}
-			send_escaped('%');
+			send_escaped(REPORT_FLIP);
 
 			// Then fill in back buffer
+			gs_buf_set_format(gs_buf_back, OUTPUT_DIRECT);
 			uint16_t bytes_read = serial_to_sram(gs_buf_back,GS_BUF_BYTES);
+			gs_buf_dirty(gs_buf_back) = ALL_LAYERS;
 
 			// Stop receiving if we receive a command
 			if (bytes_read == 0) {
@@ -243,7 +308,143 @@ void serial_elo_process(uint8_t cmd) {
 
 			// Then, allow flipping
 			allow_flipping(true);
+			grant_credit();
+		}
+	} ELSEIFCMD(CMD_DELTA_FRAME) {
+		/* Like CMD_SERIAL_FRAME, but the frames are coded as
+		 * changes to the previous one */
+		partial = false;
+		allow_jit(false);
+		allow_tween(false);
+		drop_third_buffer();
+
+		send_escaped(GS_BUF_BYTES >> 8);
+		send_escaped(GS_BUF_BYTES & 0xff);
+
+		// The first frame is coded against a black one
+		bool first = true;
+		while (true) {
+			while (flags.may_flip) {
+				sleep_mode();
+			}
+			send_escaped(REPORT_FLIP);
+
+			// Front has the previous frame
+			const uint8_t *prev = first ? NULL : gs_buf_front;
+			gs_buf_set_format(gs_buf_back, OUTPUT_DIRECT);
+			uint16_t bytes_read =
+				serial_delta_to_sram(gs_buf_back, prev,
+						     GS_BUF_BYTES);
+			gs_buf_dirty(gs_buf_back) = ALL_LAYERS;
+
+			if (bytes_read == 0) {
+				break;
+			} else if (bytes_read < GS_BUF_BYTES) {
+				send_escaped(RESP_INTERRUPTED);
+				break;
+			}
+
+			allow_flipping(true);
+			grant_credit();
+			first = false;
 		}
+	} ELSEIFCMD(CMD_PACKET_FRAME) {
+		/* Like CMD_SERIAL_FRAME, but the frames are sent as
+		 * COBS packets and an empty packet ends */
+		partial = false;
+		allow_jit(false);
+		allow_tween(false);
+		drop_third_buffer();
+
+		send_escaped(GS_BUF_BYTES >> 8);
+		send_escaped(GS_BUF_BYTES & 0xff);
+
+		while (true) {
+			while (flags.may_flip) {
+				sleep_mode();
+			}
+			send_escaped(REPORT_FLIP);
+
+			gs_buf_set_format(gs_buf_back, OUTPUT_DIRECT);
+			uint8_t r = cobs_to_sram(gs_buf_back, GS_BUF_BYTES);
+			gs_buf_dirty(gs_buf_back) = ALL_LAYERS;
+
+			if (r == COBS_END) {
+				break;
+			} else if (r == COBS_BAD) {
+				// Sender may go on with the next frame
+				send_escaped(REPORT_BAD_PACKET);
+				continue;
+			}
+
+			allow_flipping(true);
+			grant_credit();
+		}
+	} ELSEIFCMD(CMD_WRITE_LAYERS) {
+		// Layers as in frame data
+		struct {
+			uint8_t first;
+			uint8_t count;
+		} a;
+		SERIAL_READ(a);
+
+		if (a.first >= LEDS_Z)
+			goto bad_arg_a;
+
+		if (a.count > LEDS_Z - a.first)
+			goto bad_arg_b;
+
+		begin_partial();
+		for (uint8_t z = a.first; z < a.first + a.count; z++) {
+			mark_dirty(gs_buf_back, z);
+		}
+
+		const uint16_t n = a.count * BYTES_PER_LAYER;
+		if (serial_to_sram(gs_buf_back + a.first * BYTES_PER_LAYER,
+				   n) < n)
+			goto interrupted;
+	} ELSEIFCMD(CMD_WRITE_BOX) {
+		/* Corner and size of the box. Voxels follow X first,
+		 * then Y and Z, two of them packed to three bytes like
+		 * in frame data. */
+		struct {
+			uint8_t x, y, z;
+			uint8_t w, h, d;
+		} b;
+		SERIAL_READ(b);
+
+		if (b.x >= LEDS_X || b.y >= LEDS_Y || b.z >= LEDS_Z)
+			goto bad_arg_a;
+
+		if (b.w > LEDS_X - b.x || b.h > LEDS_Y - b.y ||
+		    b.d > LEDS_Z - b.z)
+			goto bad_arg_b;
+
+		begin_partial();
+		uint8_t packed[3];
+		bool odd = false;
+		for (uint8_t z = b.z; z < b.z + b.d; z++) {
+			for (uint8_t y = b.y; y < b.y + b.h; y++) {
+				for (uint8_t x = b.x; x < b.x + b.w; x++) {
+					uint16_t i;
+					if (odd) {
+						SERIAL_READ(packed[2]);
+						i = (packed[1] & 0x0f) << 8 |
+							packed[2];
+					} else {
+						if (serial_to_sram(packed, 2) < 2)
+							goto interrupted;
+						i = packed[0] << 4 | packed[1] >> 4;
+					}
+					odd = !odd;
+					set_led(x, y, z, i);
+				}
+			}
+		}
+	} ELSEIFCMD(CMD_COMMIT_FRAME) {
+		// Shows the partial updates
+		if (partial) allow_flipping(true);
+		partial = false;
 	} else {
 		report(REPORT_INVALID_CMD);
 		return;
@@ -280,4 +481,70 @@ static uint8_t answering(void) {
 	return 1;
 }
 
+/**
+ * Lets the sender start the next frame while the queued one waits for
+ * flip. The beginning of the frame waits in the receive buffer, which
+ * is empty between frames, so the credit is its capacity.
+ */
+static void grant_credit(void) {
+	if (!flags.may_flip) return; // Flipped already
+	send_escaped(REPORT_CREDIT);
+	send_escaped(RX_BUF_SIZE - 1);
+}
+
+/**
+ * Whole frames do not fit in the third buffer, so uploads go back to
+ * double buffering when a palette effect has taken it in use.
+ */
+static void drop_third_buffer(void) {
+#ifdef TRIPLE_BUFFER
+	if (!triple_active) return;
+
+	while (flags.may_flip) {
+		sleep_mode();
+	}
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		gs_restore_bufs();
+	}
+#endif
+}
+
+/**
+ * Prepares the back buffer for partial updates. The first update
+ * after a commit starts from a copy of the shown frame, or from black
+ * if there is no copy to take. Effects are stopped, because they
+ * would draw over the updates.
+ */
+static void begin_partial(void) {
+	if (partial) return;
+
+	// JIT effects render to the slots and leave front stale
+	const bool stale = jit_active;
+
+	mode = MODE_IDLE;
+	allow_jit(false);
+	allow_tween(false);
+
+	// Wait for the back buffer to get freed
+	while (flags.may_flip) {
+		sleep_mode();
+	}
+
+	// NO_FLIP effects draw to front, give back its own buffer
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		gs_restore_bufs();
+	}
+
+	// Palette, level and JIT frames are not copied
+	if (!stale && gs_buf_format(gs_buf_front) == OUTPUT_DIRECT) {
+		memcpy(gs_buf_back, gs_buf_front, GS_BUF_BYTES);
+		gs_buf_dirty(gs_buf_back) = gs_buf_dirty(gs_buf_front);
+	} else {
+		memset(gs_buf_back, 0, GS_BUF_BYTES);
+		gs_buf_dirty(gs_buf_back) = 0;
+	}
+	gs_buf_set_format(gs_buf_back, OUTPUT_DIRECT);
+	partial = true;
+}
+
 #endif // AVR_ELO
@@ -20,6 +20,7 @@
 #ifdef AVR_ELO
 
 #include <avr/pgmspace.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include "serial.h"
 #include "serial_escaped.h"
@@ -27,7 +28,6 @@
 void send_string_from_pgm(const char * const* pgm_p)
 {
 	char *p = (char*)pgm_read_word_near(pgm_p);
-	char c;
 
 	// If is NULL, print is as zero-length string
 	if ( p == NULL) {
@@ -35,18 +35,15 @@ void send_string_from_pgm(const char * const* pgm_p)
 		return;
 	}
 	
-	// Read byte-by-byte and write, including NUL byte
-	do {
-		c = pgm_read_byte_near(p++);
-		send_escaped(c);
-	} while (c != '\0');
+	// Sent straight from program memory, including NUL byte
+	serial_send_block(p, strlen_P(p) + 1, TX_PGM | TX_ESCAPE);
 }
 
 void sram_to_serial(void *src, uint16_t n)
 {
-	uint8_t *p = (uint8_t*)src;
-	for (int i=0; i<n; i++)
-		send_escaped(*p++);
+	// Source may be on stack, so it's not left to the queue
+	serial_send_block(src, n, TX_SRAM | TX_ESCAPE);
+	serial_sync();
 }
 
 uint16_t serial_to_sram(void *dest, uint16_t n)
@@ -62,6 +59,31 @@ uint16_t serial_to_sram(void *dest, uint16_t n)
 	return i;
 }
 
+uint16_t serial_delta_to_sram(uint8_t *dest, const uint8_t *prev,
+			      uint16_t n)
+{
+	uint16_t i = 0;
+	while (i < n) {
+		read_t x = read_escaped();
+		if (!x.good) break;
+
+		const bool literal = !(x.byte & 0x80);
+		const uint8_t len = (x.byte & 0x7f) + 1;
+		if (len > n - i) break;
+
+		for (uint8_t j = 0; j < len; j++, i++) {
+			uint8_t delta = 0;
+			if (literal) {
+				x = read_escaped();
+				if (!x.good) return i;
+				delta = x.byte;
+			}
+			dest[i] = (prev == NULL ? 0 : prev[i]) ^ delta;
+		}
+	}
+	return i;
+}
+
 void send_escaped(uint8_t byte) {
 	serial_send(byte);
 	if (byte == ESCAPE) serial_send(LITERAL_ESCAPE);
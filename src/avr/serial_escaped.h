@@ -51,6 +51,18 @@ void sram_to_serial(void *src, uint16_t n);
  */
 uint16_t serial_to_sram(void *dest, uint16_t n);
 
+/**
+ * Reads n bytes of delta coded data from serial port to dest. The
+ * data is XOR of the new and the previous contents, prev, which may
+ * be NULL for all zeros. It consists of tokens: byte 0x00-0x7f is
+ * followed by that many plus one literal delta bytes and byte
+ * 0x80-0xff skips that many minus 0x7f unchanged bytes. Stops like
+ * serial_to_sram() and also if a token runs past n. Returns the
+ * number of bytes decoded.
+ */
+uint16_t serial_delta_to_sram(uint8_t *dest, const uint8_t *prev,
+			      uint16_t n);
+
 /**
  * Sends a byte and escapes it if necessary.
  */
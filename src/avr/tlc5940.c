@@ -33,17 +33,71 @@
 #include "tlc5940.h"
 #include "pinMacros.h"
 #include "init.h"
+#include "sleep.h"
 #include "../common/cube.h"
+#include "../common/output.h"
 
 register uint8_t layer_bytes_left asm ("r4");
 register uint8_t *send_ptr asm ("r2");
 volatile struct flags flags = { .may_flip = false,
 				.report_flip = false,
-				.layer = 0
+				.layer = 0,
+				.jit = false,
+				.hold_blank = false,
+				.expand = false
 };
 
+volatile struct frame_stats frame_stats;
+
+uint8_t power_budget = POWER_UNLIMITED;
+volatile uint8_t frame_load;
+
+// Dimming set by the user, before limiting power
+static uint8_t user_dimming = 255;
+
+// Load and BLANK interval of the frame waiting for flip
+static volatile uint8_t next_load;
+static volatile uint8_t next_blank_interval;
+
+// Layers which are rendered to JIT slots but not yet sent
+static volatile layer_mask_t jit_ready;
+
+// Next layer to render in JIT mode
+static uint8_t jit_z;
+
+/* JIT frames are never flipped, so their load is summed from the
+ * layers sent and applied at the start of the next refresh */
+static uint8_t jit_slot_load[JIT_SLOTS];
+static uint16_t jit_load;
+
+#define LAYER_MASK ((1<<LAYER_BITS)-1)
+
+// Layers of the current frame which are known to be black
+static layer_mask_t dark_layers;
+
+// Frame being expanded by the output stage and the expanded layer
+static const uint8_t *output_src;
+static uint8_t output_buf[BYTES_PER_LAYER];
+
+// Output stage is running with interrupts enabled
+static volatile bool expanding;
+
 #define NL "\n\t"
 
+static uint8_t blank_interval(uint8_t load);
+
+/* Returns layers of a frame which are black when shown. Palette
+ * index 0 may be lit, and oriented layers are not the ones marked
+ * in the mask, so those frames have none. */
+static layer_mask_t dark_mask(const uint8_t *buf)
+{
+	if (gs_buf_format(buf) != OUTPUT_DIRECT || orientation) return 0;
+
+	layer_mask_t lit = gs_buf_dirty(buf);
+	if (tween_from != NULL) lit |= gs_buf_dirty(tween_from);
+	return ~lit;
+}
+
 /* Minimum blank interval depends on SPI clock divider. */
 #define SPI_CLOCK_DIVIDER 4
 #define MIN_BLANK_INTERVAL ((1 << SPI_CLOCK_DIVIDER) - 1)
@@ -101,6 +155,14 @@ ISR(SPI_STC_vect)
  */
 ISR(TIMER0_COMPA_vect)
 {
+	/* Expanding took longer than the layer period and we
+	 * interrupted it. Hold the current layer for another period
+	 * instead of touching the buffers in use. */
+	if (expanding) {
+		frame_stats.held++;
+		return;
+	}
+
 	// Main screen turn off
 	pin_high(BLANK);
 
@@ -108,10 +170,14 @@ ISR(TIMER0_COMPA_vect)
 	pin_high(XLAT);
 	pin_low(XLAT);
 
-	// Main screen turn on and start PWM timers on TLC5940
-	pin_low(BLANK);
+	/* Main screen turn on and start PWM timers on TLC5940 unless
+	 * there was nothing to show */
+	if (!flags.hold_blank) pin_low(BLANK);
 
-	if (flags.layer != (1<<LAYER_BITS)-1) {
+	// Main loop is stalled while waiting unless triple buffering
+	if (flags.may_flip && !triple_active) frame_stats.flip_wait++;
+
+	if (flags.layer != LAYER_MASK) {
 		// Advance layer
 		flags.layer++;
 	} else {
@@ -120,13 +186,72 @@ ISR(TIMER0_COMPA_vect)
 		
 		// If we have new buffer, flip to it
 		if (flags.may_flip) {
+			const uint8_t *old_front = gs_buf_front;
+#ifdef TRIPLE_BUFFER
+			if (triple_active) gs_buf_flip();
+			else gs_buf_swap();
+#else
 			gs_buf_swap();
+#endif
 			flags.may_flip = 0;
+			frame_stats.flips++;
+
+			// Power is limited from the first layer of the frame
+			frame_load = next_load;
+			OCR0A = next_blank_interval;
+
+			// Old frame stays put until the main loop ends tween
+			if (tween_enabled) tween_flip(old_front);
+		}
+
+		// Power of JIT frames is limited one refresh late
+		if (flags.jit) {
+			frame_load = jit_load / LEDS_Z;
+			OCR0A = blank_interval(frame_load);
 		}
+		jit_load = 0;
+		output_refresh();
 
 		// Roll send_ptr back to start of buffer
 		send_ptr = gs_buf_front;
+
+		// Rendering mode is changed only between frames
+		flags.jit = jit_active;
+		flags.expand = gs_buf_format(gs_buf_front) != OUTPUT_DIRECT ||
+			orientation || calibrated || tween_from != NULL;
+		output_src = gs_buf_front;
+		dark_layers = flags.jit ? 0 : dark_mask(gs_buf_front);
+	}
+
+	if (dark_layers & (layer_mask_t)1 << flags.layer) {
+		/* Nothing to send. Keeping outputs off shows the layer
+		 * black and saves the SPI transfer and expanding. */
+		flags.hold_blank = true;
+		return;
+	}
+
+	if (flags.jit) {
+		const layer_mask_t bit = 1 << flags.layer;
+
+		if (!(jit_ready & bit)) {
+			// Not rendered in time. Skip the layer.
+			flags.hold_blank = true;
+			return;
+		}
+		jit_ready &= ~bit;
+		jit_load += jit_slot_load[flags.layer % JIT_SLOTS];
+		send_ptr = jit_slot(flags.layer);
+	} else if (flags.expand) {
+		/* Expanding takes a while. Let serial port be served
+		 * meanwhile, SPI is not yet running. */
+		expanding = true;
+		NONATOMIC_BLOCK(NONATOMIC_FORCEOFF) {
+			output_layer(output_src, flags.layer, output_buf);
+		}
+		expanding = false;
+		send_ptr = output_buf;
 	}
+	flags.hold_blank = false;
 
 	// Send first byte
 	SPDR = ~(1<<flags.layer);
@@ -135,20 +260,124 @@ ISR(TIMER0_COMPA_vect)
 	layer_bytes_left = BYTES_PER_LAYER + 1;
 }
 
-void tlc5940_set_dimming(uint8_t x)
+/* Returns BLANK interval for showing a frame of given load. Current
+ * drawn is proportional to the load and the dimming, so the dimming
+ * is scaled down to keep their product within the budget. */
+static uint8_t blank_interval(uint8_t load)
 {
+	uint8_t x = user_dimming;
+	if (load > power_budget) x = (uint16_t)x * power_budget / load;
+
 	if (x <= MIN_BLANK_INTERVAL) {
 		/* It's dimmer than possible. Use the maximum BLANK
 		   interval */
-		OCR0A = 255;
-	} else {
-		/* Making BLANK happen slower */
-		OCR0A = ((uint16_t)MIN_BLANK_INTERVAL << 8)/x;
+		return 255;
 	}
+	/* Making BLANK happen slower */
+	return ((uint16_t)MIN_BLANK_INTERVAL << 8)/x;
+}
+
+void tlc5940_set_dimming(uint8_t x)
+{
+	user_dimming = x;
+	tlc5940_update_power();
+}
+
+void tlc5940_update_power(void)
+{
+	// Called also during initialization with interrupts disabled
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		OCR0A = blank_interval(frame_load);
+		next_blank_interval = blank_interval(next_load);
+	}
+}
+
+void allow_jit(bool state)
+{
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		jit_ready = 0;
+		jit_active = state;
+	}
+}
+
+void allow_tween(bool state)
+{
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		tween_enabled = state;
+		if (!state) tween_from = NULL;
+	}
+}
+
+uint8_t jit_next_layer(void)
+{
+	while (true) {
+		// Wait for the multiplexer to start JIT frames
+		if (!flags.jit) {
+			sleep_mode();
+			continue;
+		}
+
+		const uint8_t ahead = (jit_z - flags.layer) & LAYER_MASK;
+
+		if (ahead == 0 || ahead > JIT_SLOTS) {
+			// Fallen behind, continue from the next free slot
+			jit_z = (flags.layer + 1) & LAYER_MASK;
+		} else if (ahead < JIT_SLOTS) {
+			return jit_z;
+		} else {
+			// Slot is still waiting to be sent
+			sleep_mode();
+		}
+	}
+}
+
+void jit_commit(uint8_t z)
+{
+	const uint8_t load = estimate_layer_load(jit_slot(z));
+
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		jit_slot_load[z % JIT_SLOTS] = load;
+		// Publish only if the layer has not been passed meanwhile
+		const uint8_t ahead = (z - flags.layer) & LAYER_MASK;
+		if (flags.jit && ahead != 0 && ahead < JIT_SLOTS) {
+			jit_ready |= 1 << z;
+		}
+	}
+	jit_z = (z + 1) & LAYER_MASK;
 }
 
 void allow_flipping(bool state) {
+	/* Let the multiplexer skip black layers of the new frame and
+	 * limit its power */
+	if (state) {
+		gs_buf_trim_dirty(gs_buf_back);
+		const uint8_t load = estimate_load(gs_buf_back);
+		const uint8_t interval = blank_interval(load);
+		ATOMIC_BLOCK(ATOMIC_FORCEON) {
+			next_load = load;
+			next_blank_interval = interval;
+		}
+	}
+
 	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+#ifdef TRIPLE_BUFFER
+		/* The new frame replaces the pending one and drawing
+		 * continues to the older buffer, which may be still
+		 * tweened from */
+		if (state && triple_active) {
+			tween_end();
+			gs_buf_queue();
+		}
+#endif
 		flags.may_flip = state;
 	}
 }
+
+void take_frame_stats(struct frame_stats *s)
+{
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		*s = frame_stats;
+		frame_stats = (struct frame_stats){0};
+		s->buffers = triple_active ? 3 : 2;
+	}
+}
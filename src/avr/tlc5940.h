@@ -28,6 +28,7 @@
 #define TLC5940_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // TLC5940 pins
 #define XLAT 	B,PB1 // Data latch from shift register to the device registers
@@ -45,10 +46,34 @@ struct flags {
 	bool may_flip:1; // Outside interrupts modify only by allow_flipping()
 	bool report_flip:1;
 	uint8_t layer:LAYER_BITS;
+	bool jit:1; // Layers are taken from JIT slots during this frame
+	bool hold_blank:1; // Keep outputs off during the next layer
+	bool expand:1; // Front buffer is run through the output stage
 };
 
 extern volatile struct flags flags;
 
+// Frame pipeline counters, used for measuring drawing throughput
+struct frame_stats {
+	uint32_t flip_wait; // Layer periods a finished frame waited for flip
+	uint16_t flips;     // Frames flipped to front
+	uint16_t draws;     // Frames drawn by the main loop
+	uint16_t held;      // Layers held because expanding ran late
+	uint8_t buffers;    // Frame buffers in rotation when queried
+};
+
+extern volatile struct frame_stats frame_stats;
+
+/* Power governor. Load is the mean intensity of a frame from 0 to
+ * 255, estimated before the frame is flipped. When the load of the
+ * shown frame exceeds power_budget, the dimming is scaled down by
+ * budget / load, which keeps the current drawn by the LEDs within
+ * the budget. Dimming can not go below the minimum BLANK interval,
+ * though. */
+#define POWER_UNLIMITED 255
+extern uint8_t power_budget; // Call tlc5940_update_power() after changing
+extern volatile uint8_t frame_load; // Load of the frame shown
+
 /**
  * Set global dimming of the LED cube. Possible values range from 0 to
  * 255. It's performed by tuning BLANK interval which may lead to
@@ -57,6 +82,11 @@ extern volatile struct flags flags;
  * to turn the cube completely off. */
 void tlc5940_set_dimming(uint8_t x);
 
+/**
+ * Applies a changed power_budget.
+ */
+void tlc5940_update_power(void);
+
 /**
  * When state is true, it allows flipping of display buffers. Flipping
  * is performed later by interrupt handlers. After that,
@@ -65,4 +95,23 @@ void tlc5940_set_dimming(uint8_t x);
  */
 void allow_flipping(bool state);
 
+/**
+ * Copies frame statistics to s and resets the counters.
+ */
+void take_frame_stats(struct frame_stats *s);
+
+/**
+ * Starts or stops just-in-time rendering. Multiplexer changes the
+ * mode at the beginning of the next frame. Layers which are not
+ * rendered in time are left dark.
+ */
+void allow_jit(bool state);
+
+/**
+ * Starts or stops interpolating between frames. When enabled, the
+ * frame flipped out is mixed into the new one until tween_end() is
+ * called, which must be done before drawing to it again.
+ */
+void allow_tween(bool state);
+
 #endif /* TLC5940_H_ */
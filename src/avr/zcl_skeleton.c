@@ -23,16 +23,19 @@
 #include <avr/pgmspace.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "serial.h"
 #include "clock.h"
 #include "configuration.h"
+#include "tlc5940.h"
 #include "../common/pgmspace.h"
 #include "main.h"
 #include "serial_zcl.h"
 #include "../generated/effect_constants.h"
 #include "../common/playlists.h"
 #include "../common/time.h"
+#include "../common/output.h"
 #include "../effects/lib/font8x8.h"
 
 // Lengths
@@ -90,6 +93,14 @@
 #define ATTR_HW_VERSION 0x10
 #define ATTR_SW_VERSION 0x11
 #define ATTR_PLAYLIST_POSITION 0x13
+#define ATTR_ORIENTATION 0x14
+#define ATTR_CALIBRATION 0x15
+#define ATTR_POWER_BUDGET 0x16
+#define ATTR_FRAME_LOAD 0x17
+
+/* Calibration tables longer than an octet string are transferred as
+ * whole rows preceded by the number of the first row */
+#define CALIBRATION_ROWS ((0xfe - 1) / LEDS_X)
 
 // Data types
 #define TYPE_BOOLEAN 0x10
@@ -165,6 +176,7 @@ static void send_pgm_string(const char * const* pgm_p);
 static void send_pgm_string_direct(const char *p);
 
 static void send_payload(uint8_t);
+static void send_pgm_payload(const char *p, uint16_t len);
 static void reset_send_crc(void);
 static inline void serial_send_hex(uint8_t);
 
@@ -211,10 +223,7 @@ void process_serial(void)
 {
 	if (zcl_ati()) {
 		// ATI command response
-		for (uint8_t i = 0; i < sizeof(ati_resp)-1; i++) {
-			char c = pgm_get(ati_resp[i],byte);
-			serial_send(c);
-		}
+		serial_send_block(ati_resp, sizeof(ati_resp)-1, TX_PGM);
 
 		// MAC address, big endian, colon separated
 		serial_send_hex(mac >> 56);
@@ -461,6 +470,34 @@ static bool process_read_cmd() {
 				uint8_t start = pgm_get(playlists[active_playlist],byte);
 				send_payload(active_effect-start);
 				break;
+			case ATTR_ORIENTATION:
+				send_attr_resp_header(ATTR_ORIENTATION, TYPE_UINT8);
+				send_payload(orientation);
+				break;
+			case ATTR_CALIBRATION:
+				send_attr_resp_header(ATTR_CALIBRATION, TYPE_OCTET_STRING);
+#if CHANNELS < 0xff
+				send_payload(CHANNELS);
+				for (uint16_t i = 0; i < CHANNELS; i++) {
+					send_payload(calibration[i]);
+				}
+#else
+				// Only the first rows fit
+				send_payload(1 + CALIBRATION_ROWS * LEDS_X);
+				send_payload(0);
+				for (uint16_t i = 0; i < CALIBRATION_ROWS * LEDS_X; i++) {
+					send_payload(calibration[i]);
+				}
+#endif
+				break;
+			case ATTR_POWER_BUDGET:
+				send_attr_resp_header(ATTR_POWER_BUDGET, TYPE_UINT8);
+				send_payload(power_budget);
+				break;
+			case ATTR_FRAME_LOAD:
+				send_attr_resp_header(ATTR_FRAME_LOAD, TYPE_UINT8);
+				send_payload(frame_load);
+				break;
 			default:
 				send_cmd_status(attr, STATUS_UNSUPPORTED_ATTRIBUTE);
 				break;
@@ -634,6 +671,56 @@ static bool process_write_cmd(void) {
 				send_cmd_status(attr, STATUS_READ_ONLY);
 				success = false;
 				break;
+			case ATTR_ORIENTATION:
+				if (msg_get() == TYPE_UINT8) {
+					uint8_t x = msg_get();
+					if (x >= ORIENTATIONS) {
+						success = false;
+						send_cmd_status(attr, STATUS_INVALID_VALUE);
+					} else {
+						WET change_orientation(x);
+					}
+				} else {
+					success = false;
+					send_cmd_status(attr, STATUS_INVALID_DATA_TYPE);
+				}
+				break;
+			case ATTR_CALIBRATION:
+				if (msg_get() == TYPE_OCTET_STRING) {
+					uint8_t len = msg_get();
+					const uint8_t *p = msg_i;
+					const uint8_t rows = (len - 1) / LEDS_X;
+					if (len == CHANNELS) {
+						WET change_calibration(p, 0, CHANNELS);
+					} else if (len != 0xff && len > 1 &&
+						   (len - 1) % LEDS_X == 0 &&
+						   p[0] + rows <= LEDS_Y) {
+						WET change_calibration(p + 1, p[0] * LEDS_X,
+								       rows * LEDS_X);
+					} else {
+						success = false;
+						send_cmd_status(attr, STATUS_INVALID_VALUE);
+					}
+					if (len == 0xff) len = 0; // Invalid value
+					msg_i += len; // Put pointer to the end
+				} else {
+					success = false;
+					send_cmd_status(attr, STATUS_INVALID_DATA_TYPE);
+				}
+				break;
+			case ATTR_POWER_BUDGET:
+				if (msg_get() == TYPE_UINT8) {
+					uint8_t x = msg_get();
+					WET change_power_budget(x);
+				} else {
+					success = false;
+					send_cmd_status(attr, STATUS_INVALID_DATA_TYPE);
+				}
+				break;
+			case ATTR_FRAME_LOAD:
+				send_cmd_status(attr, STATUS_READ_ONLY);
+				success = false;
+				break;
 			default:
 				send_cmd_status(attr, STATUS_UNSUPPORTED_ATTRIBUTE);
 				success = false;
@@ -723,12 +810,8 @@ static void send_pgm_string(const char * const* pgm_p) {
  */
 static void send_pgm_string_direct(const char *p)
 {
-	// Read byte-by-byte and write, not including NUL byte
-	char c = pgm_read_byte_near(p++);
-	while (c != '\0') {
-		send_payload(c);
-		c = pgm_read_byte_near(p++);
-	}
+	// Not including NUL byte
+	send_pgm_payload(p, strlen_P(p));
 }
 
 /**
@@ -745,6 +828,22 @@ static void send_payload(uint8_t data) {
 	}
 }
 
+/**
+ * Like send_payload() for len bytes of program memory. The data is
+ * queued for sending, so the serial port does not stall the caller.
+ */
+static void send_pgm_payload(const char *p, uint16_t len) {
+	if (dry_run) {
+		response_length += len;
+		return;
+	}
+	for (uint16_t i = 0; i < len; i++) {
+		uint8_t c = pgm_read_byte_near(p + i);
+		send_crc = _crc_xmodem_update(send_crc, c);
+	}
+	serial_send_block(p, len, TX_PGM | TX_HEX);
+}
+
 /**
  * Resets the internally used send CRC value
  */
@@ -829,10 +928,7 @@ static void reset_msg_ptr(void)
 static void send_local_pgm_str_(const char *s, uint8_t len)
 {
 	send_payload(len);
-	for (uint8_t i = 0; i < len; i++) {
-		char c = pgm_get(s[i],byte);
-		send_payload(c);
-	}
+	send_pgm_payload(s, len);
 }
 
 #endif //AVR_ZCL
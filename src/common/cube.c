@@ -17,14 +17,27 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef AVR
+#include <avr/io.h>
+#endif
+#include <string.h>
 #include "cube.h"
 
 // Define the buffers for LED cube grayscale data
-uint8_t gs_buf_a[GS_BUF_BYTES]={0x00};
-uint8_t gs_buf_b[GS_BUF_BYTES]={0x00};
+struct gs_buf gs_buf_a={{0,OUTPUT_DIRECT},{0x00}};
+struct gs_buf gs_buf_b={{0,OUTPUT_DIRECT},{0x00}};
+
+uint8_t *gs_buf_front = gs_buf_a.data;
+uint8_t *gs_buf_back = gs_buf_b.data;
 
-uint8_t *gs_buf_front = gs_buf_a;
-uint8_t *gs_buf_back = gs_buf_b;
+#ifdef TRIPLE_BUFFER
+uint8_t *gs_buf_pending = NULL;
+
+// Third palette buffer with its header at the end of gs_buf_a
+#define GS_BUF_C (gs_buf_a.data + GS_BUF_BYTES - GS_BUF_PALETTE_BYTES)
+#endif
+
+volatile bool jit_active = false;
 
 void gs_buf_swap(void) {
 	uint8_t *tmp = gs_buf_front;
@@ -32,11 +45,62 @@ void gs_buf_swap(void) {
 	gs_buf_back = tmp;
 }
 
+void gs_buf_set_format(uint8_t *buf, uint8_t format) {
+	if (gs_buf_format(buf) == format) return;
+	gs_buf_format(buf) = format;
+	gs_buf_dirty(buf) = ALL_LAYERS;
+}
+
+void gs_buf_trim_dirty(uint8_t *buf) {
+	if (gs_buf_format(buf) != OUTPUT_DIRECT) return;
+
+	layer_mask_t dirty = gs_buf_dirty(buf);
+	for (uint8_t z = 0; dirty >> z; z++) {
+		if (!(dirty & (layer_mask_t)1 << z)) continue;
+
+		const uint8_t *p = buf + z * BYTES_PER_LAYER;
+		uint8_t lit = 0;
+		for (uint16_t i = 0; i < BYTES_PER_LAYER; i++) lit |= p[i];
+		if (!lit) dirty &= ~((layer_mask_t)1 << z);
+	}
+	gs_buf_dirty(buf) = dirty;
+}
+
+#ifdef TRIPLE_BUFFER
+void gs_buf_triple(void) {
+	gs_buf_format(GS_BUF_C) = OUTPUT_PALETTE;
+	gs_buf_dirty(GS_BUF_C) = ALL_LAYERS;
+	gs_buf_pending = GS_BUF_C;
+}
+
+void gs_buf_queue(void) {
+	uint8_t *tmp = gs_buf_pending;
+	gs_buf_pending = gs_buf_back;
+	gs_buf_back = tmp;
+}
+
+void gs_buf_flip(void) {
+	uint8_t *tmp = gs_buf_front;
+	gs_buf_front = gs_buf_pending;
+	gs_buf_pending = tmp;
+}
+#endif
+
 void gs_restore_bufs(void) {
-	if (gs_buf_front == gs_buf_a) {
-		gs_buf_back = gs_buf_b;
+#ifdef TRIPLE_BUFFER
+	/* The next effect may draw over the tail of gs_buf_a, so the
+	 * frame shown from there moves to its beginning */
+	if (gs_buf_front == GS_BUF_C) {
+		memcpy(gs_buf_a.data, GS_BUF_C, GS_BUF_PALETTE_BYTES);
+		gs_buf_a.head = *gs_buf_head(GS_BUF_C);
+		gs_buf_front = gs_buf_a.data;
+	}
+	gs_buf_pending = NULL;
+#endif
+	if (gs_buf_front == gs_buf_a.data) {
+		gs_buf_back = gs_buf_b.data;
 	} else {
-		gs_buf_back = gs_buf_a;
+		gs_buf_back = gs_buf_a.data;
 	}
 }
 
@@ -45,6 +109,11 @@ void gs_restore_bufs(void) {
 #error "There are more LED data on X-Y layer than there is BYTES_PER_LAYER"
 #endif
 
+// Header of the third buffer, 5 bytes at most, is stored in front of it
+#if defined(TRIPLE_BUFFER) && 2 * GS_BUF_PALETTE_BYTES + 5 > GS_BUF_BYTES
+#error "Third palette buffer does not fit in the tail of a grayscale buffer"
+#endif
+
 #if (1 << (8*SHIFT_REGISTER_BYTES)) < LEDS_Z
 #error "LEDS_Z is too large; does not fit inside SHIFT_REGISTER_BYTES"
 #endif
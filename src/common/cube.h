@@ -20,28 +20,151 @@
 #ifndef CUBE_H_
 #define CUBE_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "env.h"
 
 // Total data in a buffer
 #define GS_BUF_BYTES (LEDS_Z * BYTES_PER_LAYER)
 
+// Bit mask having one bit per layer
+#if LEDS_Z <= 8
+typedef uint8_t layer_mask_t;
+#elif LEDS_Z <= 16
+typedef uint16_t layer_mask_t;
+#else
+typedef uint32_t layer_mask_t;
+#endif
+
+#define ALL_LAYERS ((layer_mask_t)((1ULL << LEDS_Z) - 1))
+
+// Buffer contents, see output.h
+#define OUTPUT_DIRECT 0  // TLC5940 grayscale data, sent as is
+#define OUTPUT_PALETTE 1 // 4-bit palette indices, expanded per layer
+#define OUTPUT_LEVEL 2   // 8-bit perceptual levels, dithered per layer
+
+/* Grayscale buffer. Layers which are not marked dirty are known to
+ * be black. The dirty mask and the format precede the data and
+ * travel with the buffer when the buffers are swapped. */
+struct gs_buf_head {
+	layer_mask_t dirty;
+	uint8_t format;
+};
+
+struct gs_buf {
+	struct gs_buf_head head;
+	uint8_t data[GS_BUF_BYTES];
+};
+
+/* Header of the buffer pointed by buf. Pointer must be gs_buf_front,
+ * gs_buf_back or gs_buf_pending. */
+#define gs_buf_head(buf) ((struct gs_buf_head *)(buf) - 1)
+
+// Dirty mask of the buffer pointed by buf
+#define gs_buf_dirty(buf) (gs_buf_head(buf)->dirty)
+
+// Format of the buffer pointed by buf
+#define gs_buf_format(buf) (gs_buf_head(buf)->format)
+
+// Marks layer z of the buffer as possibly non-black
+#define mark_dirty(buf,z) (gs_buf_dirty(buf) |= (layer_mask_t)1 << (z))
+
 /* Front and back buffers. Front is the one being drawn on and back is
  * the one that should be manipulated by effects. There are some
  * exceptions to this rule when doing some very nasty effects. */
 extern uint8_t *gs_buf_front;
 extern uint8_t *gs_buf_back;
 
+/* Just-in-time rendering. Instead of drawing a full back buffer,
+ * layers are rendered to a small ring of layer slots just ahead of
+ * the layer being multiplexed. The slots take the beginning of the
+ * back buffer and the rest of it is free for the effect. Rendering
+ * a layer must finish within one layer period or it stays dark. */
+#ifndef JIT_SLOTS
+#define JIT_SLOTS 2
+#endif
+
+#if LEDS_Z % JIT_SLOTS != 0
+#error "LEDS_Z must be divisible by JIT_SLOTS"
+#endif
+
+// Slots are filled by the canvas packing stage
+#define JIT_SUPPORTED (GS_DEPTH == 12 && LEDS_X % 2 == 0)
+
+#define jit_slot(z) (gs_buf_back + ((z) % JIT_SLOTS) * BYTES_PER_LAYER)
+#define JIT_SCRATCH (gs_buf_back + JIT_SLOTS * BYTES_PER_LAYER)
+#define JIT_SCRATCH_BYTES (GS_BUF_BYTES - JIT_SLOTS * BYTES_PER_LAYER)
+
+// True when layers are rendered just in time
+extern volatile bool jit_active;
+
+/**
+ * Waits until a slot is free and returns the layer to render to
+ * it. Implementation is platform specific.
+ */
+uint8_t jit_next_layer(void);
+
+/**
+ * Passes the rendered layer z in jit_slot(z) to output.
+ */
+void jit_commit(uint8_t z);
+
 /**
  * Swap buffers. Call this only from interrupt handlers or places
  * where no interrupts may occur.
  */
 void gs_buf_swap(void);
 
+#ifdef TRIPLE_BUFFER
+/* Palette frames take a third of a buffer, so a third buffer for
+ * them fits in the unused tail of the first one. While it is in use
+ * drawing continues when the finished frame waits for flip. */
+#define GS_BUF_PALETTE_BYTES (LEDS_Z * LEDS_X * LEDS_Y / 2)
+
+// Finished frame waiting for flip, NULL when not triple buffering
+extern uint8_t *gs_buf_pending;
+
+#define triple_active (gs_buf_pending != NULL)
+
+/**
+ * Takes the third buffer in use. Front and back must be palette
+ * frames. Call only when flipping is not allowed. It is dropped
+ * again by gs_restore_bufs().
+ */
+void gs_buf_triple(void);
+
+/**
+ * Swaps back buffer with the pending one. The new frame replaces
+ * the pending frame. Call only when no interrupts may occur.
+ */
+void gs_buf_queue(void);
+
+/**
+ * Flips the pending frame to front. Call only from interrupt
+ * handlers.
+ */
+void gs_buf_flip(void);
+#else
+#define triple_active false
+#endif
+
+/**
+ * Changes the format of the buffer. Every layer is marked dirty
+ * because the old contents are garbage in the new format.
+ */
+void gs_buf_set_format(uint8_t *buf, uint8_t format);
+
+/**
+ * Clears dirty bits of grayscale layers which turn out to be black.
+ * The multiplexer skips black layers of the front buffer, so this is
+ * worth running before flipping. Other formats are left untouched.
+ */
+void gs_buf_trim_dirty(uint8_t *buf);
+
 /**
  * Restore buffers after NO_FLIP effect. May be safely run even if the
- * last effect was FLIP effect. Must be called when there is no
- * possibility of gs_buf_swap happening the same time.
+ * last effect was FLIP effect. Drops the third buffer, which may move
+ * the front buffer, so call with interrupts disabled.
  */
 void gs_restore_bufs(void);
 
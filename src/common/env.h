@@ -23,15 +23,19 @@
  * SHIFT_REGISTER_BYTES tells how many bytes there are in shift
  * register of Z layer switcher.
  * 
- * If you are changing LED count or GS_DEPTH, make sure you have
- * compatible implementation of set_led() in effects/lib/utils.c */
+ * Geometry may be overridden from the build. Voxel addressing code
+ * is generated for every geometry listed in generators/geometry.py,
+ * so add your geometry there if you are changing LED count or
+ * GS_DEPTH. */
 
+#ifndef LEDS_X
 #define LEDS_X 8
 #define LEDS_Y 8
 #define LEDS_Z 8
 #define GS_DEPTH 12
 #define BYTES_PER_LAYER 96
 #define SHIFT_REGISTER_BYTES 1
+#endif
 
 #ifdef AVR_ZCL
 // ZCL version uses slower baud rate due to hardware limitation
@@ -41,7 +45,5 @@
 #define BAUD 250000
 #endif
 
-/* To mirror cube coordinates, uncomment the axis. To rotate the cube
- * for 180 degrees, uncomment the both. */
-//#define MIRROR_X
-//#define MIRROR_Y
+/* Cube orientation (rotation and mirroring) is a runtime setting
+ * applied by the output stage, see common/output.h */
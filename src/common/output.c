@@ -0,0 +1,393 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "output.h"
+#include "../effects/lib/blend.h"
+#include "../effects/lib/weber_fechner.h"
+
+uint16_t palette[PALETTE_SIZE];
+uint8_t orientation = 0;
+
+uint8_t calibration[CHANNELS] = { [0 ... CHANNELS-1] = CALIBRATION_FULL };
+bool calibrated = false;
+
+bool tween_enabled = false;
+const uint8_t *tween_from = NULL;
+
+// Refreshes since the flip and the length of the interpolation
+static uint16_t tween_step;
+static uint16_t tween_steps;
+static uint8_t tween_alpha; // Weight of the new frame
+
+// Refresh counter for dithering
+static uint8_t dither_phase;
+
+// Logical axis along physical X, Y and Z for every permutation
+static const uint8_t permutations[6][3] = {
+	{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}
+};
+
+static const uint8_t axis_len[3] = {LEDS_X, LEDS_Y, LEDS_Z};
+
+// Mapping of the current orientation
+static uint8_t axis[3];
+static uint8_t flips;
+
+bool set_orientation(uint8_t o)
+{
+	if (o >= ORIENTATIONS) return false;
+
+	const uint8_t *perm = permutations[o >> 3];
+	for (uint8_t i = 0; i < 3; i++) {
+		if (axis_len[perm[i]] != axis_len[i]) return false;
+	}
+
+	memcpy(axis, perm, sizeof(axis));
+	flips = o & 7;
+	orientation = o;
+	return true;
+}
+
+void tween_flip(const uint8_t *from)
+{
+	tween_from = from;
+	tween_step = 0;
+}
+
+void output_refresh(void)
+{
+	dither_phase++;
+	if (tween_from == NULL) return;
+
+	tween_alpha = tween_step >= tween_steps ? 255 :
+		(uint32_t)tween_step * 255 / tween_steps;
+	if (tween_step != UINT16_MAX) tween_step++;
+}
+
+void tween_end(void)
+{
+	if (tween_from == NULL) return;
+
+	tween_steps = tween_step;
+	tween_from = NULL;
+}
+
+#if GS_DEPTH == 12
+/* Voxel pair of a palette byte fills exactly three bytes of
+ * grayscale data */
+static void expand_palette(const uint8_t *src, uint8_t *out)
+{
+	for (uint8_t i = 0; i < PALETTE_BYTES_PER_LAYER; i++) {
+		const uint8_t pair = *src++;
+		const uint16_t a = palette[pair >> 4];
+		const uint16_t b = palette[pair & 0x0f];
+		*out++ = a >> 4;
+		*out++ = a << 4 | b >> 8;
+		*out++ = b;
+	}
+}
+
+// Sums top 8 bits of voxel pairs
+static uint16_t sum_layer(const uint8_t *p)
+{
+	uint16_t sum = 0;
+	for (uint8_t i = 0; i < BYTES_PER_LAYER / 3; i++, p += 3) {
+		sum += p[0] + (uint8_t)(p[1] << 4 | p[2] >> 4);
+	}
+	return sum;
+}
+
+// Voxel i of a layer starts from the middle of a byte if i is odd
+uint16_t get_voxel(const uint8_t *layer, uint16_t i)
+{
+	const uint8_t *p = layer + 3 * (i >> 1);
+	if (i & 1) return (p[1] & 0x0f) << 8 | p[2];
+	return p[0] << 4 | p[1] >> 4;
+}
+
+void put_voxel(uint8_t *layer, uint16_t i, uint16_t v)
+{
+	uint8_t *p = layer + 3 * (i >> 1);
+	if (i & 1) {
+		p[1] = (p[1] & 0xf0) | v >> 8;
+		p[2] = v;
+	} else {
+		p[0] = v >> 4;
+		p[1] = (p[1] & 0x0f) | v << 4;
+	}
+}
+#else
+/* Generic packing, most significant bit first. Slow, but works on
+ * any geometry. */
+uint16_t get_voxel(const uint8_t *layer, uint16_t i)
+{
+	uint16_t v = 0;
+	for (uint16_t pos = i * GS_DEPTH; pos < (i + 1) * GS_DEPTH; pos++) {
+		v = v << 1 | (layer[pos >> 3] >> (7 - (pos & 7)) & 1);
+	}
+	return v;
+}
+
+void put_voxel(uint8_t *layer, uint16_t i, uint16_t v)
+{
+	uint16_t pos = i * GS_DEPTH;
+	for (int8_t bit = GS_DEPTH - 1; bit >= 0; bit--, pos++) {
+		const uint8_t mask = 0x80 >> (pos & 7);
+		if (v >> bit & 1) layer[pos >> 3] |= mask;
+		else layer[pos >> 3] &= ~mask;
+	}
+}
+
+static void expand_palette(const uint8_t *src, uint8_t *out)
+{
+	for (uint16_t i = 0; i < PALETTE_BYTES_PER_LAYER; i++) {
+		const uint8_t pair = *src++;
+		put_voxel(out, 2 * i, palette[pair >> 4]);
+		put_voxel(out, 2 * i + 1, palette[pair & 0x0f]);
+	}
+}
+
+static uint32_t sum_layer(const uint8_t *layer)
+{
+	uint32_t sum = 0;
+	for (uint16_t i = 0; i < LEDS_X * LEDS_Y; i++) {
+		sum += get_voxel(layer, i) >> (GS_DEPTH - 8);
+	}
+	return sum;
+}
+#endif
+
+uint8_t estimate_load(const uint8_t *buf)
+{
+	uint32_t sum = 0;
+
+	switch (gs_buf_format(buf)) {
+	case OUTPUT_PALETTE:
+		for (uint16_t i = 0; i < LEDS_Z * PALETTE_BYTES_PER_LAYER; i++) {
+			sum += (palette[buf[i] >> 4] + palette[buf[i] & 0x0f]) >>
+				(GS_DEPTH - 8);
+		}
+		break;
+	case OUTPUT_LEVEL:
+		for (uint16_t i = 0; i < LEDS_Z * LEVEL_BYTES_PER_LAYER; i++) {
+			if (buf[i]) {
+				sum += weber_fechner_fine(buf[i]) >>
+					(WEBER_FECHNER_FINE_BITS - 8);
+			}
+		}
+		break;
+	default:
+	{
+		// Black layers add nothing
+		layer_mask_t dirty = gs_buf_dirty(buf);
+		for (uint8_t z = 0; dirty; z++, dirty >>= 1) {
+			if (dirty & 1) sum += sum_layer(buf + z * BYTES_PER_LAYER);
+		}
+	}
+	}
+
+	return sum / (LEDS_X * LEDS_Y * LEDS_Z);
+}
+
+uint8_t estimate_layer_load(const uint8_t *layer)
+{
+	return sum_layer(layer) / (LEDS_X * LEDS_Y);
+}
+
+#if GS_DEPTH + DITHER_BITS <= WEBER_FECHNER_FINE_BITS
+#define DITHER_MASK ((1 << DITHER_BITS) - 1)
+
+/* Rounds fine intensity v to GS_DEPTH. The fractional part decides
+ * on how many of 2^DITHER_BITS refreshes the voxel gets one more
+ * step: those where it exceeds the threshold of the voxel. */
+static uint16_t dither(uint16_t v, uint8_t threshold)
+{
+	const uint8_t shift = WEBER_FECHNER_FINE_BITS - GS_DEPTH;
+	const uint16_t out = (v >> shift) +
+		((v >> (shift - DITHER_BITS) & DITHER_MASK) > threshold);
+
+	return out >> GS_DEPTH ? (1 << GS_DEPTH) - 1 : out;
+}
+
+/* Threshold of voxel i on this refresh. Neighbouring voxels are out
+ * of phase to hide flicker. */
+static uint8_t dither_threshold(uint16_t i)
+{
+	const uint8_t offset = ((i ^ i / LEDS_X) & 1) << 1 | (i / LEDS_X & 1);
+	return (dither_phase + offset) & DITHER_MASK;
+}
+
+// Intensity of level of voxel i on this refresh
+static uint16_t dither_level(uint8_t level, uint16_t i)
+{
+	return dither(weber_fechner_fine(level), dither_threshold(i));
+}
+#else
+static uint16_t dither_level(uint8_t level, uint16_t i)
+{
+	return (uint32_t)weber_fechner_fine(level) << GS_DEPTH >>
+		WEBER_FECHNER_FINE_BITS;
+}
+#endif
+
+#if GS_DEPTH == 12 && LEDS_X % 2 == 0
+/* Levels are expanded in voxel pairs like palette indices. Voxels of
+ * the same parity of x and y share the threshold, so the thresholds
+ * are taken once per layer and a voxel costs a table lookup and a
+ * compare. */
+static void expand_levels(const uint8_t *src, uint8_t *out)
+{
+	const uint8_t t[2][2] = {
+		{ dither_threshold(0), dither_threshold(1) },
+		{ dither_threshold(LEDS_X), dither_threshold(LEDS_X + 1) }
+	};
+
+	for (uint8_t y = 0; y < LEDS_Y; y++) {
+		const uint8_t *row_t = t[y & 1];
+		for (uint8_t x = 0; x < LEDS_X; x += 2) {
+			const uint16_t a = dither(weber_fechner_fine(*src++),
+						  row_t[0]);
+			const uint16_t b = dither(weber_fechner_fine(*src++),
+						  row_t[1]);
+			*out++ = a >> 4;
+			*out++ = a << 4 | b >> 8;
+			*out++ = b;
+		}
+	}
+}
+#else
+static void expand_levels(const uint8_t *src, uint8_t *out)
+{
+	for (uint16_t i = 0; i < LEVEL_BYTES_PER_LAYER; i++) {
+		put_voxel(out, i, dither_level(src[i], i));
+	}
+}
+#endif
+
+// Reads intensity of a logical voxel from a single frame
+static uint16_t read_frame_voxel(const uint8_t *buf, const uint8_t *l)
+{
+	const uint16_t i = l[0] + LEDS_X * l[1];
+
+	if (gs_buf_format(buf) == OUTPUT_PALETTE) {
+		const uint8_t pair = buf[l[2] * PALETTE_BYTES_PER_LAYER + i / 2];
+		return palette[i & 1 ? pair & 0x0f : pair >> 4];
+	}
+	if (gs_buf_format(buf) == OUTPUT_LEVEL) {
+		return dither_level(buf[l[2] * LEVEL_BYTES_PER_LAYER + i], i);
+	}
+	return get_voxel(buf + l[2] * BYTES_PER_LAYER, i);
+}
+
+// Reads intensity of a logical voxel, mixed if tweening
+static uint16_t read_voxel(const uint8_t *buf, const uint8_t *l)
+{
+	const uint16_t v = read_frame_voxel(buf, l);
+	if (tween_from == NULL) return v;
+
+	const uint16_t w = tween_alpha + (tween_alpha >> 7);
+	return ((uint32_t)read_frame_voxel(tween_from, l) * (256 - w) +
+		(uint32_t)v * w) >> 8;
+}
+
+/* Collects the physical layer voxel by voxel from the logical
+ * coordinates */
+static void orient_layer(const uint8_t *buf, uint8_t z, uint8_t *out)
+{
+	uint8_t l[3];
+
+	l[axis[2]] = flips & 4 ? LEDS_Z-1-z : z;
+	for (uint8_t y = 0; y < LEDS_Y; y++) {
+		l[axis[1]] = flips & 2 ? LEDS_Y-1-y : y;
+		for (uint8_t x = 0; x < LEDS_X; x++) {
+			l[axis[0]] = flips & 1 ? LEDS_X-1-x : x;
+			put_voxel(out, x + LEDS_X * y, read_voxel(buf, l));
+		}
+	}
+}
+
+// Converts a layer before calibration
+static void render_layer(const uint8_t *buf, uint8_t z, uint8_t *out)
+{
+#if LEDS_X * LEDS_Y * GS_DEPTH < 8 * BYTES_PER_LAYER
+	// Voxels are written one by one, keep the padding black
+	memset(out, 0, BYTES_PER_LAYER);
+#endif
+
+	/* Other formats are mixed voxel by voxel. This may take longer
+	 * than a layer period, the multiplexer holds the layer then. */
+	if (orientation || (tween_from != NULL &&
+			    gs_buf_format(buf) != OUTPUT_DIRECT)) {
+		orient_layer(buf, z, out);
+		return;
+	}
+
+	if (tween_from != NULL) {
+		memcpy(out, tween_from + z * BYTES_PER_LAYER, BYTES_PER_LAYER);
+		blend_layer(out, buf + z * BYTES_PER_LAYER, BLEND_MIX,
+			    tween_alpha);
+		return;
+	}
+
+	switch (gs_buf_format(buf)) {
+	case OUTPUT_PALETTE:
+		expand_palette(buf + z * PALETTE_BYTES_PER_LAYER, out);
+		break;
+	case OUTPUT_LEVEL:
+		expand_levels(buf + z * LEVEL_BYTES_PER_LAYER, out);
+		break;
+	default:
+		memcpy(out, buf + z * BYTES_PER_LAYER, BYTES_PER_LAYER);
+	}
+}
+
+/* Scales the channels of a physical layer by their calibration. The
+ * product is split at bit 4 of the intensity to keep it in 16 bits,
+ * which gives the same result as v * (c + 1) >> 8. */
+static void calibrate_layer(uint8_t *out)
+{
+	for (uint16_t i = 0; i < CHANNELS; i++) {
+		const uint8_t c = calibration[i];
+		if (c == CALIBRATION_FULL) continue;
+
+		const uint16_t v = get_voxel(out, i);
+		const uint16_t k = c + 1;
+#if GS_DEPTH <= 12
+		put_voxel(out, i, ((v >> 4) * k + ((v & 0x0f) * k >> 4)) >> 4);
+#else
+		put_voxel(out, i, (uint32_t)v * k >> 8);
+#endif
+	}
+}
+
+void output_layer(const uint8_t *buf, uint8_t z, uint8_t *out)
+{
+	render_layer(buf, z, out);
+	if (calibrated) calibrate_layer(out);
+}
+
+void update_calibration(void)
+{
+	bool any = false;
+	for (uint16_t i = 0; i < CHANNELS; i++) {
+		if (calibration[i] != CALIBRATION_FULL) any = true;
+	}
+	calibrated = any;
+}
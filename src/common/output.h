@@ -0,0 +1,149 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stdint.h>
+#include "cube.h"
+
+/* Output stage converts a layer of a buffer which is not in
+ * OUTPUT_DIRECT format, not in the identity orientation, calibrated
+ * or interpolated to TLC5940 grayscale data. It is run by the multiplexer just before
+ * sending the layer and by the exporter. */
+
+/* Palette buffers store one 4-bit index per voxel. Voxel x is in
+ * the high nibble when x is even. A buffer takes only a third of
+ * the memory of grayscale data, and fading all voxels of the same
+ * color is done by changing a single palette entry. */
+#define PALETTE_SIZE 16
+#define PALETTE_BYTES_PER_LAYER (LEDS_X * LEDS_Y / 2)
+
+#if (LEDS_X * LEDS_Y) % 2 != 0
+#error "Palette mode requires even number of voxels per layer"
+#endif
+
+// Intensities of palette indices. Index 0 is black after effect change.
+extern uint16_t palette[PALETTE_SIZE];
+
+/* Level buffers store one byte per voxel. Levels are mapped to
+ * intensities through a Weber–Fechner table which is more precise
+ * than GS_DEPTH. The extra DITHER_BITS are spread over as many
+ * refreshes by temporal dithering, which smooths fades at low
+ * intensities. Level 0 is black. */
+#define LEVEL_BYTES_PER_LAYER (LEDS_X * LEDS_Y)
+#define DITHER_BITS 2
+
+#if LEDS_Z * LEVEL_BYTES_PER_LAYER > GS_BUF_BYTES
+#error "Level mode requires at least 8-bit grayscale buffer"
+#endif
+
+/* Cube orientation. Effects draw in logical coordinates and the
+ * output stage maps them to physical voxels. The value is 8 *
+ * permutation + flips. Permutation (0-5) tells which logical axes
+ * lie along physical X, Y and Z: XYZ, XZY, YXZ, YZX, ZXY or ZYX.
+ * Bits 0-2 of flips reverse physical X, Y and Z. For example, 1
+ * mirrors X and 3 rotates the cube 180 degrees around Z axis. */
+#define ORIENTATIONS 48
+extern uint8_t orientation;
+
+/* Channel calibration. Every TLC5940 channel drives a column of
+ * LEDs, one per layer, which vary in brightness. The output stage
+ * scales intensity of physical voxel i = x + LEDS_X * y of every
+ * layer by (calibration[i] + 1) / 256. Call update_calibration()
+ * after changing the table. Layers are not run through the output
+ * stage for calibration if all channels are at full scale. */
+#define CHANNELS (LEDS_X * LEDS_Y)
+#define CALIBRATION_FULL 0xff
+extern uint8_t calibration[CHANNELS];
+extern bool calibrated; // Some channel is not at full scale
+
+/**
+ * Updates calibrated after changing calibration table.
+ */
+void update_calibration(void);
+
+/* Frame interpolation. When tween_enabled is set, the previous
+ * frame stays in the buffer it was flipped out to and the output
+ * stage mixes it into the new frame. The weight of the new frame
+ * rises from zero to full during as many refreshes as the previous
+ * frame was shown, which looks smooth for effects drawing at low
+ * rate. The multiplexer and exporter call tween_flip() when a frame
+ * is flipped and output_refresh() on every refresh. The frame mixed
+ * from must not be drawn to before calling tween_end(). The
+ * multiplexer mixes with interrupts enabled but never re-enters the
+ * output stage, so tween state changes only between layers. */
+extern bool tween_enabled;
+extern const uint8_t *tween_from; // Previous frame, NULL if not tweening
+
+/**
+ * Starts mixing from the given previous frame.
+ */
+void tween_flip(const uint8_t *from);
+
+/**
+ * Advances interpolation and dithering. Call at the first layer of
+ * every refresh.
+ */
+void output_refresh(void);
+
+/**
+ * Stops mixing. Time since the flip is used as the length of the
+ * next interpolation.
+ */
+void tween_end(void);
+
+/**
+ * Sets cube orientation. Returns false if the orientation is out of
+ * range or swaps axes of different length. Call with interrupts
+ * disabled when the multiplexer is running.
+ */
+bool set_orientation(uint8_t o);
+
+/**
+ * Returns intensity of voxel i = x + LEDS_X * y of a grayscale
+ * layer.
+ */
+uint16_t get_voxel(const uint8_t *layer, uint16_t i);
+
+/**
+ * Sets intensity of voxel i = x + LEDS_X * y of a grayscale layer.
+ */
+void put_voxel(uint8_t *layer, uint16_t i, uint16_t v);
+
+/**
+ * Estimates power drawn by showing buf. Returns the mean intensity of
+ * voxels scaled to 0-255, where 255 is every voxel at full
+ * intensity. Calibration and dithering are ignored.
+ */
+uint8_t estimate_load(const uint8_t *buf);
+
+/**
+ * Estimates power drawn by showing a single layer in the grayscale
+ * format, like estimate_load().
+ */
+uint8_t estimate_layer_load(const uint8_t *layer);
+
+/**
+ * Converts physical layer z of buf to grayscale data in out. The
+ * format is taken from buf. Output must have room for BYTES_PER_LAYER bytes.
+ */
+void output_layer(const uint8_t *buf, uint8_t z, uint8_t *out);
+
+#endif /* OUTPUT_H_ */
@@ -20,10 +20,18 @@
 /* The C file for this header is automatically generated and located
  * at ../generated/playlists.c */
 
+// Overlay of items having no overlay effect
+#define NO_OVERLAY 0xff
+
 typedef struct {
 	uint8_t id;
 	uint16_t length;
 	const void *data;
+	uint8_t overlay; // Effect drawn on top of this one
+	uint8_t blend;   // Blend mode of the overlay, see blend.h
+	uint8_t alpha;   // Opacity of the overlay in BLEND_ALPHA and MIX
+	uint8_t transition;         // From previous item, see transition.h
+	uint16_t transition_length; // In ticks
 } playlistitem_t;
 
 extern const playlistitem_t master_playlist[];
@@ -0,0 +1,146 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cube.h"
+#include "output.h"
+#include "transition.h"
+#include "../effects/lib/blend.h"
+
+#define LAYER_VOXELS (LEDS_X * LEDS_Y)
+
+bool transition_active = false;
+
+static struct {
+	uint8_t type;
+	uint16_t length;
+	uint8_t kept; // Weight of the old frame in front buffer
+} transition;
+
+bool transition_start(uint8_t type, uint16_t length)
+{
+	transition_active = false;
+
+	// Frames are combined as grayscale data
+	if (type == TRANSITION_NONE || !length ||
+	    gs_buf_format(gs_buf_front) != OUTPUT_DIRECT ||
+	    gs_buf_format(gs_buf_back) != OUTPUT_DIRECT) {
+		return false;
+	}
+
+	transition.type = type;
+	transition.length = length;
+	transition.kept = 255;
+	transition_active = true;
+	return true;
+}
+
+/* Front holds the previous result, so the old frame is faded out by
+ * mixing in front with weight relative to the previous one. Recent
+ * frames of the new effect leave a short trail while fading in. */
+static void crossfade(const uint8_t *old, uint8_t progress)
+{
+	const uint8_t kept = 255 - progress;
+	const uint8_t alpha = transition.kept ?
+		(uint16_t)kept * 255 / transition.kept : 0;
+	const layer_mask_t old_dirty = gs_buf_dirty(old);
+
+	transition.kept = kept;
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		const layer_mask_t bit = (layer_mask_t)1 << z;
+		if (!((old_dirty | gs_buf_dirty(gs_buf_back)) & bit)) continue;
+
+		// Layers which are not dirty are zeros
+		blend_layer(gs_buf_back + z * BYTES_PER_LAYER,
+			    old + z * BYTES_PER_LAYER, BLEND_MIX, alpha);
+		gs_buf_dirty(gs_buf_back) |= old_dirty & bit;
+	}
+}
+
+// Position of a voxel in the order of dissolving
+static uint8_t dissolve_rank(uint16_t v)
+{
+	return (uint16_t)(v * 40503U) >> 8;
+}
+
+/* Copies the voxels which still show the old frame. Z wipe moves
+ * whole layers. */
+static void keep_old(const uint8_t *old, uint8_t progress)
+{
+	const layer_mask_t old_dirty = gs_buf_dirty(old);
+	const uint8_t edge_x = (uint16_t)progress * LEDS_X >> 8;
+	const uint8_t edge_y = (uint16_t)progress * LEDS_Y >> 8;
+	const uint8_t edge_z = (uint16_t)progress * LEDS_Z >> 8;
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		const layer_mask_t bit = (layer_mask_t)1 << z;
+		uint8_t *dst = gs_buf_back + z * BYTES_PER_LAYER;
+		const uint8_t *src = old + z * BYTES_PER_LAYER;
+
+		if (!((old_dirty | gs_buf_dirty(gs_buf_back)) & bit)) continue;
+
+		if (transition.type == TRANSITION_WIPE_Z) {
+			if (z < edge_z) continue;
+			memcpy(dst, src, BYTES_PER_LAYER);
+			gs_buf_dirty(gs_buf_back) &= ~bit;
+			gs_buf_dirty(gs_buf_back) |= old_dirty & bit;
+			continue;
+		}
+
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			for (uint8_t x = 0; x < LEDS_X; x++) {
+				const uint16_t i = x + LEDS_X * y;
+				bool old_voxel;
+
+				switch (transition.type) {
+				case TRANSITION_WIPE_X:
+					old_voxel = x >= edge_x;
+					break;
+				case TRANSITION_WIPE_Y:
+					old_voxel = y >= edge_y;
+					break;
+				default:
+					old_voxel = dissolve_rank(
+						i + z * LAYER_VOXELS) >= progress;
+				}
+				if (old_voxel) put_voxel(dst, i, get_voxel(src, i));
+			}
+		}
+		gs_buf_dirty(gs_buf_back) |= old_dirty & bit;
+	}
+}
+
+void transition_apply(uint16_t ticks)
+{
+	if (!transition_active) return;
+	if (ticks >= transition.length) {
+		transition_active = false;
+		return;
+	}
+
+	const uint8_t *old = gs_buf_front;
+	const uint8_t progress = (uint32_t)ticks * 256 / transition.length;
+
+	if (transition.type == TRANSITION_CROSSFADE) {
+		crossfade(old, progress);
+	} else {
+		keep_old(old, progress);
+	}
+}
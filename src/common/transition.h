@@ -0,0 +1,54 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSITION_H_
+#define TRANSITION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Transitions between playlist items. The outgoing frame stays in
+ * the front buffer when the next effect starts. Every frame of the
+ * new effect is then combined with the front buffer before it is
+ * flipped. Parts still showing the old effect are copied from front
+ * again, so no extra frame buffer is needed. */
+#define TRANSITION_NONE 0
+#define TRANSITION_CROSSFADE 1 // Old frame fades out linearly
+#define TRANSITION_WIPE_X 2    // New effect sweeps in along X axis
+#define TRANSITION_WIPE_Y 3
+#define TRANSITION_WIPE_Z 4
+#define TRANSITION_DISSOLVE 5  // Voxels change in random order
+
+/**
+ * Starts a transition from the contents of the front buffer. Length
+ * is in ticks. Returns false, if the front buffer can not be used,
+ * in which case effects must be changed without a transition.
+ */
+bool transition_start(uint8_t type, uint16_t length);
+
+/**
+ * Combines the frame just drawn to the back buffer with the front
+ * buffer. Ticks is the time since the start of the transition.
+ */
+void transition_apply(uint16_t ticks);
+
+// True while a transition is running
+extern bool transition_active;
+
+#endif /* TRANSITION_H_ */
@@ -21,7 +21,11 @@
 
 #include "common.h"
 
-XYZ(effect)
+CANVAS(effect)
 {
-	set_led(x, y, z, MAX_INTENSITY);
+	for(uint8_t y = 0; y < LEDS_Y; y++) {
+		for(uint8_t x = 0; x < LEDS_X; x++) {
+			canvas[y][x] = MAX_INTENSITY;
+		}
+	}
 }
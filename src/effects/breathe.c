@@ -0,0 +1,41 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Layers fade in and out one after another on the perceptual scale.
+ * Dithering keeps the dim end of the fade smooth. */
+
+# pragma FLIP
+# pragma DITHER
+
+#include "common.h"
+
+void effect(void)
+{
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		// Triangle wave of about four seconds, delayed per layer
+		const uint16_t t = (ticks + z * 32) & 511;
+		const uint8_t level = t < 256 ? t : 511 - t;
+
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			for (uint8_t x = 0; x < LEDS_X; x++) {
+				set_level(x, y, z, level);
+			}
+		}
+	}
+}
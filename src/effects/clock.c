@@ -37,6 +37,8 @@ void init(void)
 
 void effect(void)
 {
+	bitplane_t plane;
+
 	vars.text.len=CLOCK_CHARS;
 	const struct glyph **buf = vars.text.buf;
 
@@ -56,12 +58,14 @@ void effect(void)
 	buf[6] = get_glyph_ascii('0'+(secs/10));
 	buf[7] = get_glyph_ascii('0'+(secs%10));
 
-	clear_buffer();
+	bitplane_use(plane);
+	bitplane_clear();
 
 	/* Position is calculated with modulus to keep it rolling over
 	 * and over again */
 	int16_t pos = (ticks >> 3) % ((CLOCK_CHARS+4)*8);
 
-	scroll_text(&vars.text, MEM_SRAM, pos, render_xy);
-	scroll_text(&vars.text, MEM_SRAM, pos-7, render_yz);
+	scroll_text(&vars.text, MEM_SRAM, pos, bit_render_xy);
+	scroll_text(&vars.text, MEM_SRAM, pos-7, bit_render_yz);
+	bitplane_expand(MAX_INTENSITY);
 }
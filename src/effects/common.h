@@ -22,9 +22,16 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include "lib/automaton.h"
+#include "lib/bitplane.h"
+#include "lib/canvas.h"
+#include "lib/level.h"
 #include "lib/math.h"
+#include "lib/palette.h"
 #include "lib/utils.h"
 #include "lib/shapes.h"
+#include "lib/shift.h"
+#include "lib/sparse.h"
 #include "lib/text.h"
 #include "lib/weber_fechner.h"
 #include "../common/env.h"
@@ -21,7 +21,13 @@
 
 #include "common.h"
 
-XY(effect)
+CANVAS(effect)
 {
-	set_led(x, y, 3, MAX_INTENSITY);
+	if (z != 3) return;
+
+	for(uint8_t y = 0; y < LEDS_Y; y++) {
+		for(uint8_t x = 0; x < LEDS_X; x++) {
+			canvas[y][x] = MAX_INTENSITY;
+		}
+	}
 }
@@ -19,6 +19,7 @@
 
 # pragma FLIP
 # pragma MAX_FPS 1
+# pragma TWEEN
 
 #include "common.h"
 
@@ -33,14 +34,18 @@ void init(void) {
 
 void effect(void)
 {
+	bitplane_t plane;
+
 	vars.text.len = 2;
 	vars.text.buf[0] = get_glyph_ascii('0' + (vars.cur / 10));
 	vars.text.buf[1] = get_glyph_ascii('0' + (vars.cur % 10));
 
-	clear_buffer();
+	bitplane_use(plane);
+	bitplane_clear();
 
-	scroll_text(&vars.text, MEM_SRAM, 9, render_yz);
-	scroll_text(&vars.text, MEM_SRAM, 16, render_xy);
+	scroll_text(&vars.text, MEM_SRAM, 9, bit_render_yz);
+	scroll_text(&vars.text, MEM_SRAM, 16, bit_render_xy);
+	bitplane_expand(MAX_INTENSITY);
 
 	if(vars.cur > 0) vars.cur--;
 }
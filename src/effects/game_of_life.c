@@ -18,50 +18,60 @@
  */
 
 # pragma FLIP
-# pragma MAX_FPS 10
 
 #include "common.h"
 
-static uint8_t get_amount_of_neighbours(uint8_t x, uint8_t y, uint8_t z);
-static void set_leds(uint8_t x, uint8_t y, uint8_t z);
+/* Live cell survives with 5 to 14 neighbours and dead cell is born
+ * with 6 to 15. Random cells are born to keep the cube alive. */
+static const struct ca_rule life_rule = {6, 15, 5, 14};
 
 struct {
-	uint8_t is_alive;
+	bitplane_t plane;
 } vars;
 
+static void life_seed(void);
+
 void init(void)
 {
+	bitplane_use(vars.plane);
 	// TODO: might want to use some other seed. using heart for testing
-	heart_shape(WEBER_FECHNER_MAX);
+	life_seed();
+	bitplane_expand(MAX_INTENSITY);
 }
 
 void effect(void) {
-	vars.is_alive = 0;
-	iterate_xyz(set_leds);
+	// Overlay may have drawn to another plane
+	bitplane_use(vars.plane);
+	ca_step(&life_rule);
 
-	if(!vars.is_alive) {
-		heart_shape(WEBER_FECHNER_MAX);
+	bool is_alive = false;
+	for(uint8_t z = 0; z < LEDS_Z; z++) {
+		for(uint8_t y = 0; y < LEDS_Y; y++) {
+			// About every eighth cell
+			bitplane[z][y] |= rand() & rand() & rand();
+			is_alive |= bitplane[z][y] != 0;
+		}
 	}
-}
 
-void set_leds(uint8_t x, uint8_t y, uint8_t z)
-{
-	uint8_t neighbours = get_amount_of_neighbours((int8_t)x, (int8_t)y, (int8_t)z);
+	if(!is_alive) life_seed();
 
-	if((neighbours >= 6 && neighbours <= 15) || randint(0, 10) > 8) {
-		set_led(x, y, z, MAX_INTENSITY);
-		vars.is_alive = 1;
-	}
-	else set_led(x, y, z, 0);
+	bitplane_expand(MAX_INTENSITY);
 }
 
-static uint8_t get_amount_of_neighbours(uint8_t x, uint8_t y, uint8_t z) {
-	uint8_t ret = 0;
-
-	for(int8_t cx = -1; cx <= 1; cx++)
-		for(int8_t cy = -1; cy <= 1; cy++)
-			for(int8_t cz = -1; cz <= 1; cz++)
-				ret += get_led_wrap(x + cx, y + cy, z + cz) > 0;
+/* Heart shape, same as heart_shape() */
+static void life_seed(void)
+{
+	static const uint8_t rows[7][2] PROGMEM = {
+		{1, 6}, {0, 7}, {0, 7}, {0, 7}, {1, 6}, {2, 5}, {3, 4}
+	};
 
-	return ret;
+	bitplane_clear();
+	for(uint8_t z = 0; z < 7; z++) {
+		for(uint8_t y = pgm_get(rows[z][0], byte);
+		    y <= pgm_get(rows[z][1], byte); y++) {
+			bitplane[z][y] = 0x7e;
+		}
+	}
+	// Notch on top
+	bitplane[0][3] = bitplane[0][4] = 0;
 }
@@ -28,11 +28,9 @@ void effect(void)
 
 	clear_buffer();
 
-	for(int8_t i = 0; i < LEDS_X; i++) {
-		for(uint8_t j = 0; j < LEDS_Z; j++) {
-			fac = j <= cur? (cur - j) * 0.1: 0.0;
+	for(uint8_t j = 0; j <= cur; j++) {
+		fac = (cur - j) * 0.1;
 
-			set_row(i, LEDS_Z - 1 - j, 0, 7, MAX_INTENSITY * fac);
-		}
+		fill_xy_plane(LEDS_Z - 1 - j, MAX_INTENSITY * fac);
 	}
 }
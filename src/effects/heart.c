@@ -19,8 +19,11 @@
 
 #include "common.h"
 
+/* The heart is drawn only once. Beating is done by changing the
+ * intensities of the palette. */
+
 #pragma MAX_FPS 25
-#pragma FLIP
+#pragma PALETTE
 
 struct {
 	uint8_t y;
@@ -29,14 +32,16 @@ struct {
 void init(void)
 {
 	vars.y = 255;
+	clear_indices();
+	heart_indices();
 }
-		
 
 void effect(void)
 {
-	clear_buffer();
 	// vars.y rolls over, do not care
 	vars.y -= (160-sensors.distance1+40)/10;
 
-	heart_shape(vars.y);
+	palette[1] = weber_fechner(vars.y >> 2);
+	palette[2] = weber_fechner(vars.y >> 1);
+	palette[3] = weber_fechner(vars.y);
 }
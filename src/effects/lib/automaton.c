@@ -0,0 +1,175 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Bit-sliced 3D cellular automaton. Every bit of a word is a cell
+ * and neighbour counts are kept in bit planes, so all cells of a
+ * word are counted at once with full adders.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../../common/env.h"
+#include "bitplane.h"
+#include "automaton.h"
+
+#if !defined(AVR) && LEDS_X == 8 && LEDS_Y == 8
+/* On host the whole layer fits in a single 64-bit word */
+#define CA_WIDE
+typedef uint64_t ca_word_t;
+#define CA_WORDS 1
+#define LANES(v) ((ca_word_t)(v) * 0x0101010101010101ULL)
+#define x_prev(v) (((v) << 1 & ~LANES(0x01)) | ((v) >> 7 & LANES(0x01)))
+#define x_next(v) (((v) >> 1 & ~LANES(0x80)) | ((v) << 7 & LANES(0x80)))
+#define y_prev(v,w) ((v)[0] << LEDS_X | (v)[0] >> (64 - LEDS_X))
+#define y_next(v,w) ((v)[0] >> LEDS_X | (v)[0] << (64 - LEDS_X))
+#else
+/* Otherwise a word is a row. On AVR this keeps all arithmetic 8-bit */
+typedef bitplane_row_t ca_word_t;
+#define CA_WORDS LEDS_Y
+#define ROW_MASK ((ca_word_t)((1ULL << LEDS_X) - 1))
+#define x_prev(v) ((ca_word_t)((v) << 1 | (v) >> (LEDS_X - 1)) & ROW_MASK)
+#define x_next(v) ((ca_word_t)((v) >> 1 | (v) << (LEDS_X - 1)) & ROW_MASK)
+#define y_prev(v,w) ((v)[(w) ? (w) - 1 : CA_WORDS - 1])
+#define y_next(v,w) ((v)[(w) + 1 < CA_WORDS ? (w) + 1 : 0])
+#endif
+
+// Enough bits to count the 27 cells of a 3x3x3 block
+#define COUNT_BITS 5
+
+/* Sum of 3x3 cells around each cell of a layer, 0..9 */
+typedef ca_word_t layer_sum_t[CA_WORDS][4];
+
+static inline ca_word_t full_add(ca_word_t a, ca_word_t b, ca_word_t c,
+				 ca_word_t *carry)
+{
+	const ca_word_t t = a ^ b;
+	*carry = (a & b) | (t & c);
+	return t ^ c;
+}
+
+static void load_layer(uint8_t z, ca_word_t *cells)
+{
+	memcpy(cells, bitplane[z], sizeof(bitplane[z]));
+}
+
+static void layer_sum(const ca_word_t *cells, layer_sum_t out)
+{
+	ca_word_t lo[CA_WORDS], hi[CA_WORDS];
+
+	// Count in X direction, 0..3
+	for (uint8_t w = 0; w < CA_WORDS; w++) {
+		const ca_word_t c = cells[w];
+		lo[w] = full_add(x_prev(c), c, x_next(c), &hi[w]);
+	}
+
+	// Add neighbours in Y direction, 0..9
+	for (uint8_t w = 0; w < CA_WORDS; w++) {
+		ca_word_t k0, k1, k2;
+		out[w][0] = full_add(y_prev(lo, w), lo[w], y_next(lo, w), &k0);
+		const ca_word_t t = full_add(y_prev(hi, w), hi[w],
+					     y_next(hi, w), &k1);
+		out[w][1] = t ^ k0;
+		k2 = t & k0;
+		out[w][2] = k1 ^ k2;
+		out[w][3] = k1 & k2;
+	}
+}
+
+/* Returns cells which have count of at least k */
+static ca_word_t at_least(const ca_word_t *count, uint8_t k)
+{
+	if (k >= 1 << COUNT_BITS) return 0;
+
+	ca_word_t gt = 0;
+	ca_word_t eq = ~(ca_word_t)0;
+
+	for (int8_t i = COUNT_BITS - 1; i >= 0; i--) {
+		if (k >> i & 1) {
+			eq &= count[i];
+		} else {
+			gt |= eq & count[i];
+			eq &= ~count[i];
+		}
+	}
+	return gt | eq;
+}
+
+static ca_word_t in_range(const ca_word_t *count, uint8_t min, uint8_t max)
+{
+	return at_least(count, min) & ~at_least(count, max + 1);
+}
+
+bool ca_step(const struct ca_rule *rule)
+{
+	layer_sum_t sums[3];
+	layer_sum_t *prev = &sums[0], *cur = &sums[1], *next = &sums[2];
+	ca_word_t first[CA_WORDS], cells[CA_WORDS];
+	ca_word_t alive = 0;
+
+	// Original layer 0 is needed again when the last layer is done
+	load_layer(0, first);
+	load_layer(LEDS_Z - 1, cells);
+	layer_sum(cells, *prev);
+	layer_sum(first, *cur);
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		if (z + 1 < LEDS_Z) {
+			load_layer(z + 1, cells);
+			layer_sum(cells, *next);
+		} else {
+			layer_sum(first, *next);
+		}
+
+		load_layer(z, cells);
+		for (uint8_t w = 0; w < CA_WORDS; w++) {
+			ca_word_t count[COUNT_BITS], carry[4];
+
+			// Add the three layers. The cell itself is counted, too.
+			for (uint8_t i = 0; i < 4; i++) {
+				count[i] = full_add((*prev)[w][i], (*cur)[w][i],
+						    (*next)[w][i], &carry[i]);
+			}
+			ca_word_t c = 0;
+			for (uint8_t i = 1; i < COUNT_BITS; i++) {
+				const ca_word_t s = i < 4 ? count[i] : 0;
+				count[i] = full_add(s, carry[i-1], c, &c);
+			}
+
+			cells[w] =
+				(cells[w] & in_range(count, rule->survive_min + 1,
+						     rule->survive_max + 1)) |
+				(~cells[w] & in_range(count, rule->birth_min,
+						      rule->birth_max));
+#ifndef CA_WIDE
+			cells[w] &= ROW_MASK;
+#endif
+			alive |= cells[w];
+		}
+		memcpy(bitplane[z], cells, sizeof(bitplane[z]));
+
+		layer_sum_t *tmp = prev;
+		prev = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	return alive;
+}
@@ -0,0 +1,42 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_AUTOMATON_H
+#define EFFECT_AUTOMATON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Rule of a 3D cellular automaton. Counts are the number of live
+ * cells among the 26 neighbours. The cube wraps around on every
+ * axis. */
+struct ca_rule {
+	uint8_t birth_min;   // Dead cell is born with this many neighbours
+	uint8_t birth_max;
+	uint8_t survive_min; // Live cell stays alive with this many neighbours
+	uint8_t survive_max;
+};
+
+/**
+ * Advances the automaton stored in the bit plane by one
+ * generation. Returns true if any cell is alive afterwards.
+ */
+bool ca_step(const struct ca_rule *rule);
+
+#endif // EFFECT_AUTOMATON_H
@@ -0,0 +1,141 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Bit plane representation of the cube
+ */
+
+#include "../../common/assert.h"
+#include <stdint.h>
+#include <string.h>
+#include "../../common/env.h"
+#include "../../common/cube.h"
+#include "../../common/output.h"
+#include "blend.h"
+#include "utils.h"
+#include "bitplane.h"
+
+bitplane_row_t (*bitplane)[LEDS_Y];
+
+void bitplane_clear(void)
+{
+	memset(bitplane, 0, sizeof(bitplane_t));
+}
+
+void bitplane_fill_layer(uint8_t z)
+{
+	assert(z < LEDS_Z);
+	memset(bitplane[z], 0xff, sizeof(bitplane[z]));
+}
+
+#if GS_DEPTH == 12 && LEDS_X % 2 == 0
+void bitplane_expand(uint16_t on)
+{
+	assert(on <= MAX_INTENSITY);
+
+	/* Packed bytes of all four combinations of two neighbouring
+	 * voxels. Index bit 0 is the first voxel of a pair. */
+	uint8_t pairs[4][3];
+	for (uint8_t p = 0; p < 4; p++) {
+		const uint16_t a = p & 1 ? on : 0;
+		const uint16_t b = p & 2 ? on : 0;
+		pairs[p][0] = a >> 4;
+		pairs[p][1] = (a << 4) | (b >> 8);
+		pairs[p][2] = b;
+	}
+
+	const layer_mask_t old_dirty = gs_buf_dirty(gs_buf_back);
+	layer_mask_t dirty = 0;
+
+	// Overlays are expanded to a layer and composited
+	const bool blend = blend_mode != BLEND_NONE;
+	uint8_t layer[BYTES_PER_LAYER];
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		uint8_t *out = blend ? layer :
+			gs_buf_back + z * BYTES_PER_LAYER;
+		bitplane_row_t lit = 0;
+
+		for (uint8_t y = 0; y < LEDS_Y; y++) lit |= bitplane[z][y];
+
+		// Unlit layers are cleared only if there is something
+		if (!lit || !on) {
+			if (blend) {
+				memset(layer, 0, BYTES_PER_LAYER);
+				blend_back_layer(z, layer, false);
+			} else if (old_dirty & ((layer_mask_t)1 << z)) {
+				memset(out, 0, BYTES_PER_LAYER);
+			}
+			continue;
+		}
+		dirty |= (layer_mask_t)1 << z;
+
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			bitplane_row_t row = bitplane[z][y];
+			for (uint8_t x = 0; x < LEDS_X; x += 2) {
+				const uint8_t *q = pairs[row & 3];
+				row >>= 2;
+				*out++ = q[0];
+				*out++ = q[1];
+				*out++ = q[2];
+			}
+		}
+		if (blend) blend_back_layer(z, layer, true);
+	}
+
+	if (!blend) gs_buf_dirty(gs_buf_back) = dirty;
+}
+#else
+// Other geometries have no voxel pairs, so just plot the voxels
+void bitplane_expand(uint16_t on)
+{
+	if (blend_mode != BLEND_NONE) {
+		uint8_t layer[BYTES_PER_LAYER];
+		for (uint8_t z = 0; z < LEDS_Z; z++) {
+			bool lit = false;
+			for (uint8_t y = 0; y < LEDS_Y; y++) {
+				for (uint8_t x = 0; x < LEDS_X; x++) {
+					const uint16_t v =
+						bit_get(x, y, z) ? on : 0;
+					put_voxel(layer, x + LEDS_X * y, v);
+					lit |= v != 0;
+				}
+			}
+			blend_back_layer(z, layer, lit);
+		}
+		return;
+	}
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			for (uint8_t x = 0; x < LEDS_X; x++) {
+				set_led(x, y, z, bit_get(x, y, z) ? on : 0);
+			}
+		}
+	}
+}
+#endif
+
+void bit_render_yz(uint8_t x, uint8_t y) {
+	bit_set(7, x, y);
+}
+
+void bit_render_xy(uint8_t x, uint8_t y) {
+	bit_set(LEDS_X - x - 1, 7, y);
+}
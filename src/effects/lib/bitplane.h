@@ -0,0 +1,71 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_BITPLANE_H
+#define EFFECT_BITPLANE_H
+
+#include <stdint.h>
+#include "../../common/env.h"
+
+/* One bit per voxel. Bit x of a row is voxel x. */
+#if LEDS_X <= 8
+typedef uint8_t bitplane_row_t;
+#elif LEDS_X <= 16
+typedef uint16_t bitplane_row_t;
+#else
+typedef uint32_t bitplane_row_t;
+#endif
+
+typedef bitplane_row_t bitplane_t[LEDS_Z][LEDS_Y];
+
+/* Bit plane the functions below work on, for effects which have only
+ * lit and unlit voxels. The plane takes no static SRAM: effects which
+ * keep it between frames have it in their vars and the others on the
+ * stack. Set it with bitplane_use() before drawing. */
+extern bitplane_row_t (*bitplane)[LEDS_Y];
+
+#define bitplane_use(plane) (bitplane = (plane))
+
+#define bit_set(x,y,z) (bitplane[z][y] |= (bitplane_row_t)1 << (x))
+#define bit_clear(x,y,z) (bitplane[z][y] &= ~((bitplane_row_t)1 << (x)))
+#define bit_get(x,y,z) ((bitplane[z][y] >> (x)) & 1)
+
+/**
+ * Clears all bits
+ */
+void bitplane_clear(void);
+
+/**
+ * Sets all bits of layer z
+ */
+void bitplane_fill_layer(uint8_t z);
+
+/**
+ * Converts bit plane to back buffer. Set bits get intensity on and
+ * cleared bits are black.
+ */
+void bitplane_expand(uint16_t on);
+
+/**
+ * Render helpers for text functions
+ */
+void bit_render_yz(uint8_t x, uint8_t y);
+void bit_render_xy(uint8_t x, uint8_t y);
+
+#endif // EFFECT_BITPLANE_H
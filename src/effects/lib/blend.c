@@ -0,0 +1,211 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Compositing stage for packed grayscale layers
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "../../common/env.h"
+#include "../../common/cube.h"
+#include "../../common/output.h"
+#include "utils.h"
+#include "blend.h"
+
+uint8_t blend_mode = BLEND_NONE;
+uint8_t blend_alpha = 255;
+
+#define LAYER_VOXELS (LEDS_X * LEDS_Y)
+
+#if defined AVR && GS_DEPTH == 12 && LEDS_X % 2 == 0
+/* Blends a voxel. Mode is a constant after inlining, so the switch
+ * disappears from the loops below. W is alpha scaled to 0..256. */
+static inline __attribute__((always_inline))
+uint16_t blend_voxel(uint16_t a, uint16_t b, uint8_t mode, uint16_t w)
+{
+	uint32_t x;
+
+	switch (mode) {
+	case BLEND_ADD:
+		a += b;
+		return a > MAX_INTENSITY ? MAX_INTENSITY : a;
+	case BLEND_MAX:
+		return a > b ? a : b;
+	case BLEND_MULTIPLY:
+		// Division by MAX_INTENSITY without dividing
+		x = (uint32_t)a * b;
+		return (x + (x >> GS_DEPTH) + (1 << (GS_DEPTH-1))) >> GS_DEPTH;
+	case BLEND_ALPHA:
+		if (!b) return a;
+		// Fall through
+	case BLEND_MIX:
+		return ((uint32_t)a * (256 - w) + (uint32_t)b * w) >> 8;
+	default:
+		return b;
+	}
+}
+
+/* Two voxels next to each other share three bytes, so both layers
+ * are walked a voxel pair at a time. */
+static inline __attribute__((always_inline))
+void blend_pairs(uint8_t *dst, const uint8_t *src, uint8_t mode, uint16_t w)
+{
+	for (uint16_t i = 0; i < LAYER_VOXELS / 2; i++) {
+		const uint16_t a0 = dst[0] << 4 | dst[1] >> 4;
+		const uint16_t a1 = (dst[1] & 0x0f) << 8 | dst[2];
+		const uint16_t b0 = src[0] << 4 | src[1] >> 4;
+		const uint16_t b1 = (src[1] & 0x0f) << 8 | src[2];
+		const uint16_t r0 = blend_voxel(a0, b0, mode, w);
+		const uint16_t r1 = blend_voxel(a1, b1, mode, w);
+
+		*dst++ = r0 >> 4;
+		*dst++ = (r0 << 4) | (r1 >> 8);
+		*dst++ = r1;
+		src += 3;
+	}
+}
+
+void blend_layer(uint8_t *dst, const uint8_t *src, uint8_t mode,
+		 uint8_t alpha)
+{
+	const uint16_t w = alpha + (alpha >> 7);
+
+	switch (mode) {
+	case BLEND_ADD:
+		blend_pairs(dst, src, BLEND_ADD, w);
+		break;
+	case BLEND_MAX:
+		blend_pairs(dst, src, BLEND_MAX, w);
+		break;
+	case BLEND_MULTIPLY:
+		blend_pairs(dst, src, BLEND_MULTIPLY, w);
+		break;
+	case BLEND_ALPHA:
+		blend_pairs(dst, src, BLEND_ALPHA, w);
+		break;
+	case BLEND_MIX:
+		blend_pairs(dst, src, BLEND_MIX, w);
+		break;
+	default:
+		memcpy(dst, src, 3 * LAYER_VOXELS / 2);
+	}
+}
+#else
+/* Voxels are unpacked to vectors of 32-bit lanes and blended a
+ * vector at a time. Compilers map these to SIMD instructions where
+ * available. Results are identical to the voxel pair loops on AVR. */
+#define LANES 8
+#define VECTORS ((LAYER_VOXELS + LANES - 1) / LANES)
+
+typedef uint32_t lanes_t __attribute__ ((vector_size (LANES * 4)));
+
+static void unpack(lanes_t *v, const uint8_t *layer)
+{
+	memset(v, 0, VECTORS * sizeof(lanes_t));
+	for (uint16_t i = 0; i < LAYER_VOXELS; i++) {
+		v[i / LANES][i % LANES] = get_voxel(layer, i);
+	}
+}
+
+void blend_layer(uint8_t *dst, const uint8_t *src, uint8_t mode,
+		 uint8_t alpha)
+{
+	const uint32_t w = alpha + (alpha >> 7);
+	lanes_t a[VECTORS];
+	lanes_t b[VECTORS];
+
+	unpack(a, dst);
+	unpack(b, src);
+
+	// Comparisons give all ones in lanes where true
+	switch (mode) {
+	case BLEND_ADD:
+		for (uint16_t i = 0; i < VECTORS; i++) {
+			const lanes_t x = a[i] + b[i];
+			const lanes_t m = (lanes_t)(x > MAX_INTENSITY);
+			a[i] = (x & ~m) | (m & MAX_INTENSITY);
+		}
+		break;
+	case BLEND_MAX:
+		for (uint16_t i = 0; i < VECTORS; i++) {
+			const lanes_t m = (lanes_t)(a[i] > b[i]);
+			a[i] = (a[i] & m) | (b[i] & ~m);
+		}
+		break;
+	case BLEND_MULTIPLY:
+		// Division by MAX_INTENSITY without dividing
+		for (uint16_t i = 0; i < VECTORS; i++) {
+			const lanes_t x = a[i] * b[i];
+			a[i] = (x + (x >> GS_DEPTH) + (1 << (GS_DEPTH-1))) >>
+				GS_DEPTH;
+		}
+		break;
+	case BLEND_ALPHA:
+		for (uint16_t i = 0; i < VECTORS; i++) {
+			const lanes_t x = (a[i] * (256 - w) + b[i] * w) >> 8;
+			const lanes_t m = (lanes_t)(b[i] != 0);
+			a[i] = (x & m) | (a[i] & ~m);
+		}
+		break;
+	case BLEND_MIX:
+		for (uint16_t i = 0; i < VECTORS; i++) {
+			a[i] = (a[i] * (256 - w) + b[i] * w) >> 8;
+		}
+		break;
+	default:
+		memcpy(a, b, sizeof(a));
+	}
+
+	for (uint16_t i = 0; i < LAYER_VOXELS; i++) {
+		put_voxel(dst, i, a[i / LANES][i % LANES]);
+	}
+}
+#endif
+
+void blend_back_layer(uint8_t z, const uint8_t *src, bool lit)
+{
+	uint8_t *dst = gs_buf_back + z * BYTES_PER_LAYER;
+	const layer_mask_t bit = (layer_mask_t)1 << z;
+	const bool black = !(gs_buf_dirty(gs_buf_back) & bit);
+
+	if (!lit) {
+		switch (blend_mode) {
+		case BLEND_NONE:
+		case BLEND_MULTIPLY:
+			// Black source masks everything
+			if (!black) memset(dst, 0, BYTES_PER_LAYER);
+			gs_buf_dirty(gs_buf_back) &= ~bit;
+			return;
+		case BLEND_MIX:
+			// Black source only dims
+			if (black) return;
+			break;
+		default:
+			// Black source changes nothing
+			return;
+		}
+	}
+
+	// Nothing to dim on a black layer
+	if (black && blend_mode == BLEND_MULTIPLY) return;
+
+	blend_layer(dst, src, blend_mode, blend_alpha);
+	gs_buf_dirty(gs_buf_back) |= bit;
+}
@@ -0,0 +1,58 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_BLEND_H
+#define EFFECT_BLEND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Blend modes of the compositing stage. Source is the layer being
+ * drawn and destination the layer already in the back buffer. */
+#define BLEND_NONE 0     // Source overwrites destination
+#define BLEND_ADD 1      // Sum, saturated to MAX_INTENSITY
+#define BLEND_MAX 2      // Brighter of the two
+#define BLEND_MULTIPLY 3 // Source dims destination, black masks out
+#define BLEND_ALPHA 4    // Lit source voxels cover by alpha/255
+#define BLEND_MIX 5      // All source voxels cover by alpha/255
+#define BLEND_MODES 6
+
+/* Mode of the layer stages. When other than BLEND_NONE, CANVAS
+ * kernels and bitplane_expand() composite their layers over the
+ * back buffer instead of overwriting it. This is how an overlay
+ * effect is drawn on top of another one. */
+extern uint8_t blend_mode;
+extern uint8_t blend_alpha;
+
+/**
+ * Composites grayscale layer src over dst with given mode. Alpha is
+ * used by BLEND_ALPHA and BLEND_MIX only.
+ */
+void blend_layer(uint8_t *dst, const uint8_t *src, uint8_t mode,
+		 uint8_t alpha);
+
+/**
+ * Composites grayscale layer src over layer z of the back buffer
+ * using blend_mode and blend_alpha, and updates the dirty mask. Lit
+ * tells if there is anything in src, which allows skipping the work
+ * in most modes.
+ */
+void blend_back_layer(uint8_t z, const uint8_t *src, bool lit);
+
+#endif // EFFECT_BLEND_H
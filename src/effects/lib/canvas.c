@@ -0,0 +1,161 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Unpacked drawing canvas and packing stage
+ */
+
+#include "../../common/assert.h"
+#include <stdint.h>
+#include <string.h>
+#include "../../common/env.h"
+#include "../../common/cube.h"
+#include "../../common/output.h"
+#include "blend.h"
+#include "utils.h"
+#include "canvas.h"
+
+#if JIT_SUPPORTED
+static uint16_t pack(uint8_t *p, canvas_t canvas);
+#endif
+
+#ifndef AVR
+bool canvas_reference = false;
+bool canvas_used = false;
+
+/* Stores the canvas the traditional way. Used as a benchmark
+ * reference only. */
+static void plot_layer(uint8_t z, canvas_t canvas)
+{
+	for (uint8_t y = 0; y < LEDS_Y; y++) {
+		for (uint8_t x = 0; x < LEDS_X; x++) {
+			if (canvas[y][x]) set_led(x, y, z, canvas[y][x]);
+		}
+	}
+}
+#endif
+
+void iterate_canvas(iterate_canvas_t f)
+{
+	canvas_t canvas;
+
+#ifndef AVR
+	canvas_used = true;
+	if (canvas_reference) clear_buffer();
+#endif
+
+#if JIT_SUPPORTED
+	if (jit_active) {
+		/* Render in the order the layers are multiplexed. Every
+		 * layer is rendered once per call. */
+		for (uint8_t i = 0; i < LEDS_Z; i++) {
+			const uint8_t z = jit_next_layer();
+
+			memset(canvas, 0, sizeof(canvas_t));
+			f(z, canvas);
+			pack(jit_slot(z), canvas);
+			jit_commit(z);
+		}
+		return;
+	}
+#endif
+
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		memset(canvas, 0, sizeof(canvas_t));
+		f(z, canvas);
+#ifndef AVR
+		if (canvas_reference) {
+			plot_layer(z, canvas);
+			continue;
+		}
+#endif
+		pack_layer(z, canvas);
+	}
+}
+
+#if GS_DEPTH == 12 && LEDS_X % 2 == 0
+/* Packs the canvas to the given layer memory. Returns non-zero if
+ * any voxel is lit. */
+static uint16_t pack(uint8_t *p, canvas_t canvas)
+{
+	uint16_t lit = 0;
+
+	/* Two voxels next to each other on X axis share three bytes:
+	 * first voxel takes 8 bits and the upper nibble of the middle
+	 * byte and second one the rest. */
+	for (uint8_t y = 0; y < LEDS_Y; y++) {
+		const uint16_t *row = canvas[y];
+		for (uint8_t x = 0; x < LEDS_X; x += 2) {
+			const uint16_t a = row[x];
+			const uint16_t b = row[x+1];
+			assert(a <= MAX_INTENSITY);
+			assert(b <= MAX_INTENSITY);
+			lit |= a | b;
+
+			*p++ = a >> 4;
+			*p++ = (a << 4) | (b >> 8);
+			*p++ = b;
+		}
+	}
+
+	return lit;
+}
+
+void pack_layer(uint8_t z, canvas_t canvas)
+{
+	assert(z < LEDS_Z);
+
+	// Overlays are composited over the layer already drawn
+	if (blend_mode != BLEND_NONE) {
+		uint8_t layer[BYTES_PER_LAYER];
+		blend_back_layer(z, layer, pack(layer, canvas));
+		return;
+	}
+
+	// Layer is known to be black if nothing was drawn
+	if (pack(gs_buf_back + z * BYTES_PER_LAYER, canvas)) {
+		mark_dirty(gs_buf_back, z);
+	} else {
+		gs_buf_dirty(gs_buf_back) &= ~((layer_mask_t)1 << z);
+	}
+}
+#else
+// Other geometries have no voxel pairs, so just plot the voxels
+void pack_layer(uint8_t z, canvas_t canvas)
+{
+	if (blend_mode != BLEND_NONE) {
+		uint8_t layer[BYTES_PER_LAYER];
+		bool lit = false;
+		for (uint8_t y = 0; y < LEDS_Y; y++) {
+			for (uint8_t x = 0; x < LEDS_X; x++) {
+				put_voxel(layer, x + LEDS_X * y, canvas[y][x]);
+				lit |= canvas[y][x] != 0;
+			}
+		}
+		blend_back_layer(z, layer, lit);
+		return;
+	}
+
+	for (uint8_t y = 0; y < LEDS_Y; y++) {
+		for (uint8_t x = 0; x < LEDS_X; x++) {
+			set_led(x, y, z, canvas[y][x]);
+		}
+	}
+}
+#endif
@@ -0,0 +1,64 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_CANVAS_H
+#define EFFECT_CANVAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../../common/env.h"
+
+/* Unpacked working canvas holding one X-Y layer, one word per
+ * voxel. Canvas kernels draw to this and the packing stage converts
+ * it to the TLC5940 format once per layer. */
+typedef uint16_t canvas_t[LEDS_Y][LEDS_X];
+
+/* Generates wrapper function for layer-at-a-time canvas drawing. The
+ * kernel is called once per layer with a black canvas and writes
+ * intensities to canvas[y][x]. There is no need to clear the buffer
+ * because every layer is overwritten when the canvas is packed. */
+#define CANVAS(wrap)							\
+  static void wrap##_kernel(uint8_t z, canvas_t canvas);		\
+  static void wrap(void){iterate_canvas(&wrap##_kernel);}		\
+  static void wrap##_kernel(uint8_t z, canvas_t canvas)
+
+typedef void(*iterate_canvas_t)(uint8_t,canvas_t);
+
+/**
+ * Iterates all layers, draws them to a canvas with the given kernel
+ * and packs the results to the back buffer. The canvas is allocated
+ * from stack so it takes SRAM only while drawing.
+ */
+void iterate_canvas(iterate_canvas_t f);
+
+/**
+ * Packs the given canvas to layer z of the back buffer. Intensities
+ * must be in range 0..MAX_INTENSITY.
+ */
+void pack_layer(uint8_t z, canvas_t canvas);
+
+#ifndef AVR
+/* Benchmarking aids for exporter. When canvas_reference is set, the
+ * canvas is stored voxel by voxel with set_led() instead of
+ * packing. canvas_used is set every time a canvas is drawn. */
+extern bool canvas_reference;
+extern bool canvas_used;
+#endif
+
+#endif // EFFECT_CANVAS_H
@@ -0,0 +1,47 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "level.h"
+#include "../../common/assert.h"
+
+void set_level(uint8_t x, uint8_t y, uint8_t z, uint8_t level)
+{
+	assert(x < LEDS_X);
+	assert(y < LEDS_Y);
+	assert(z < LEDS_Z);
+
+	gs_buf_back[z * LEVEL_BYTES_PER_LAYER + x + LEDS_X * y] = level;
+	if (level) mark_dirty(gs_buf_back, z);
+}
+
+uint8_t get_level(uint8_t x, uint8_t y, uint8_t z)
+{
+	assert(x < LEDS_X);
+	assert(y < LEDS_Y);
+	assert(z < LEDS_Z);
+
+	return gs_buf_front[z * LEVEL_BYTES_PER_LAYER + x + LEDS_X * y];
+}
+
+void clear_levels(void)
+{
+	memset(gs_buf_back, 0, LEDS_Z * LEVEL_BYTES_PER_LAYER);
+	gs_buf_dirty(gs_buf_back) = 0;
+}
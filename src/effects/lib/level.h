@@ -0,0 +1,45 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_LEVEL_H
+#define EFFECT_LEVEL_H
+
+#include <stdint.h>
+#include "../../common/output.h"
+
+/* Drawing functions for effects having `# pragma DITHER`. Those
+ * effects draw perceptual levels from 0 to 255 instead of
+ * intensities. See output.h. */
+
+/**
+ * Sets voxel to given level
+ */
+void set_level(uint8_t x, uint8_t y, uint8_t z, uint8_t level);
+
+/**
+ * Gets level of a voxel in front buffer
+ */
+uint8_t get_level(uint8_t x, uint8_t y, uint8_t z);
+
+/**
+ * Sets all voxels of back buffer to level 0
+ */
+void clear_levels(void);
+
+#endif // EFFECT_LEVEL_H
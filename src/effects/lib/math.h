@@ -17,6 +17,11 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef EFFECT_MATH_H
+#define EFFECT_MATH_H
+
+#include <stdint.h>
+
 // math utils from
 // ftp://ftp.isc.org/pub/usenet/comp.sources.unix/volume26/line3d
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -34,3 +39,5 @@ typedef struct {
 uint8_t randint(uint8_t min, uint8_t max);
 uint8_t clamp(uint8_t a, uint8_t min, uint8_t max);
 float fclamp(float a, float min, float max);
+
+#endif // EFFECT_MATH_H
@@ -0,0 +1,58 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "palette.h"
+#include "../../common/assert.h"
+
+
+void set_index(uint8_t x, uint8_t y, uint8_t z, uint8_t index)
+{
+	assert(x < LEDS_X);
+	assert(y < LEDS_Y);
+	assert(z < LEDS_Z);
+	assert(index < PALETTE_SIZE);
+
+	const uint16_t i = x + LEDS_X * y;
+	uint8_t *p = gs_buf_back + z * PALETTE_BYTES_PER_LAYER + i / 2;
+	if (i & 1) *p = (*p & 0xf0) | index;
+	else *p = (*p & 0x0f) | index << 4;
+}
+
+uint8_t get_index(uint8_t x, uint8_t y, uint8_t z)
+{
+	assert(x < LEDS_X);
+	assert(y < LEDS_Y);
+	assert(z < LEDS_Z);
+
+	const uint16_t i = x + LEDS_X * y;
+	const uint8_t p = gs_buf_front[z * PALETTE_BYTES_PER_LAYER + i / 2];
+	return i & 1 ? p & 0x0f : p >> 4;
+}
+
+void fill_index_y_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2,
+		      uint8_t index)
+{
+	for (uint8_t y = y1; y <= y2; y++) set_index(x, y, z, index);
+}
+
+void clear_indices(void)
+{
+	memset(gs_buf_back, 0, LEDS_Z * PALETTE_BYTES_PER_LAYER);
+}
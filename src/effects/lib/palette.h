@@ -0,0 +1,51 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_PALETTE_H
+#define EFFECT_PALETTE_H
+
+#include <stdint.h>
+#include "../../common/output.h"
+
+/* Drawing functions for effects having `# pragma PALETTE`. Those
+ * effects draw palette indices instead of intensities and set the
+ * intensities to palette[]. */
+
+/**
+ * Sets voxel to given palette index
+ */
+void set_index(uint8_t x, uint8_t y, uint8_t z, uint8_t index);
+
+/**
+ * Gets palette index of a voxel in front buffer
+ */
+uint8_t get_index(uint8_t x, uint8_t y, uint8_t z);
+
+/**
+ * Sets voxels y1..y2 on row x, z to given palette index.
+ */
+void fill_index_y_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2,
+		      uint8_t index);
+
+/**
+ * Sets all voxels of back buffer to index 0
+ */
+void clear_indices(void);
+
+#endif // EFFECT_PALETTE_H
@@ -22,7 +22,11 @@
 #include <stdlib.h>
 #include "math.h"
 #include "utils.h"
+#include "canvas.h"
+#include "bitplane.h"
+#include "palette.h"
 #include "weber_fechner.h"
+#include "../../common/pgmspace.h"
 
 void circle_shape(int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max, uint16_t intensity)
 {
@@ -40,19 +44,43 @@ void circle_shape(int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max,
 	}
 }
 
+void circle_bits(int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max)
+{
+	xi -= LEDS_X / 2;
+	yi -= LEDS_Y / 2;
+
+	for(int8_t x = xi; x < LEDS_X + xi; x++) {
+		for(int8_t y = yi; y < LEDS_Y + yi; y++) {
+			float sq = x * x + y * y;
+
+			if(rsq_min < sq && sq < rsq_max) {
+				bit_set(x - xi, y - yi, zi);
+			}
+		}
+	}
+}
+
 void fish_shape(uint8_t xi, uint8_t yi, uint8_t zi, uint16_t intensity)
 {
-	if(xi > 0) set_row(xi - 1, zi + 1, yi + 1, yi + 4, intensity);
+	if(xi > 0) fill_y_row(xi - 1, zi + 1, yi + 1, yi + 4, intensity);
 
 	set_led(xi, yi, zi, intensity);
-	set_row(xi, zi, yi + 2, yi + 4, intensity);
-	set_row(xi, zi + 1, yi, yi + 5, intensity);
-	set_row(xi, zi + 2, yi + 2, yi + 3, intensity);
+	fill_y_row(xi, zi, yi + 2, yi + 4, intensity);
+	fill_y_row(xi, zi + 1, yi, yi + 5, intensity);
+	fill_y_row(xi, zi + 2, yi + 2, yi + 3, intensity);
 	set_led(xi, yi, zi + 2, intensity);
 
-	if(xi < LEDS_X - 1) set_row(xi + 1, zi + 1, yi + 1, yi + 4, intensity);
+	if(xi < LEDS_X - 1) fill_y_row(xi + 1, zi + 1, yi + 1, yi + 4, intensity);
 }
 
+// Rows of a heart layer: z, y1, y2
+static const uint8_t heart_rows[][3] PROGMEM = {
+	{0, 1, 2}, {0, 5, 6}, {1, 0, 7}, {2, 0, 7},
+	{3, 0, 7}, {4, 1, 6}, {5, 2, 5}, {6, 3, 4}
+};
+
+#define HEART_ROWS (sizeof(heart_rows) / sizeof(heart_rows[0]))
+
 static void heart_layer(uint8_t x, uint8_t raw);
 
 void heart_shape(uint8_t i)
@@ -67,14 +95,24 @@ void heart_shape(uint8_t i)
 
 static void heart_layer(uint8_t x, uint8_t raw_i) {
 	uint16_t intensity = weber_fechner(raw_i);
-	set_row(x, 0, 1, 2, intensity);
-	set_row(x, 0, 5, 6, intensity);
-	set_row(x, 1, 0, 7, intensity);
-	set_row(x, 2, 0, 7, intensity);
-	set_row(x, 3, 0, 7, intensity);
-	set_row(x, 4, 1, 6, intensity);
-	set_row(x, 5, 2, 5, intensity);
-	set_row(x, 6, 3, 4, intensity);
+	for (uint8_t r = 0; r < HEART_ROWS; r++) {
+		fill_y_row(x, pgm_get(heart_rows[r][0],byte),
+			   pgm_get(heart_rows[r][1],byte),
+			   pgm_get(heart_rows[r][2],byte), intensity);
+	}
+}
+
+void heart_indices(void)
+{
+	// Outer layers get index 1 and the middle ones index 3
+	for (uint8_t x = 1; x <= 6; x++) {
+		const uint8_t index = x <= 3 ? x : 7 - x;
+		for (uint8_t r = 0; r < HEART_ROWS; r++) {
+			fill_index_y_row(x, pgm_get(heart_rows[r][0],byte),
+					 pgm_get(heart_rows[r][1],byte),
+					 pgm_get(heart_rows[r][2],byte), index);
+		}
+	}
 }
 
 void sphere_shape(float xi, float yi, float zi, float rsq_min, float rsq_max, float fac)
@@ -92,6 +130,30 @@ void sphere_shape(float xi, float yi, float zi, float rsq_min, float rsq_max, fl
 	}
 }
 
+void sphere_layer(canvas_t canvas, uint8_t z, int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max, float fac)
+{
+	/* Squared distances are integers, so the bounds can be
+	 * rounded once to keep floats out of the voxel loop. */
+	const int16_t sq_min = floor(rsq_min * fac);
+	const int16_t sq_max = ceil(rsq_max * fac);
+	const int8_t zf = zi + z;
+	const int16_t zsq = zf * zf;
+
+	for(uint8_t y = 0; y < LEDS_Y; y++) {
+		const int8_t yf = yi + y;
+		const int16_t yzsq = yf * yf + zsq;
+
+		for(uint8_t x = 0; x < LEDS_X; x++) {
+			const int8_t xf = xi + x;
+			const int16_t sq = xf * xf + yzsq;
+
+			if(sq_min < sq && sq < sq_max) {
+				canvas[y][x] = MAX_INTENSITY;
+			}
+		}
+	}
+}
+
 /*
  * Bresenham's algorithm in 3D.
  *
@@ -18,9 +18,12 @@
  */
 
 void circle_shape(int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max, uint16_t intensity);
+void circle_bits(int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max);
 void fish_shape(uint8_t xi, uint8_t yi, uint8_t zi, uint16_t intensity);
 void heart_shape(uint8_t i);
+void heart_indices(void);
 void sphere_shape(float xi, float yi, float zi, float rsq_min, float rsq_max, float fac);
+void sphere_layer(canvas_t canvas, uint8_t z, int8_t xi, int8_t yi, int8_t zi, float rsq_min, float rsq_max, float fac);
 void line(uint8_t x1, uint8_t y1, uint8_t z1, uint8_t x2, uint8_t y2, uint8_t z2,
 	uint16_t intensity);
 void cube_shape(uint8_t x1, uint8_t y1, uint8_t z1, uint8_t x2, uint8_t y2, uint8_t z2,
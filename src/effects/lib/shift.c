@@ -0,0 +1,203 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Whole cube shift and roll
+ */
+
+#include "../../common/assert.h"
+#include <stdint.h>
+#include <string.h>
+#include "../../common/env.h"
+#include "../../common/cube.h"
+#include "utils.h"
+#include "shift.h"
+
+static const uint8_t axis_len[3] = {LEDS_X, LEDS_Y, LEDS_Z};
+
+static void move_voxels(uint8_t axis, int8_t n, bool wrap);
+
+void shift_voxels(uint8_t axis, int8_t n)
+{
+	move_voxels(axis, n, false);
+}
+
+void roll_voxels(uint8_t axis, int8_t n)
+{
+	move_voxels(axis, n, true);
+}
+
+// Dirty mask of layers after moving along Z axis
+static layer_mask_t move_mask(layer_mask_t m, int8_t n, bool wrap)
+{
+	// Shifts are kept shorter than the mask, wider are undefined
+	if (!wrap && (n >= LEDS_Z || -n >= LEDS_Z)) return 0;
+	if (n == 0) return m;
+
+	layer_mask_t a, b;
+	if (n > 0) {
+		a = (layer_mask_t)(m << n);
+		b = (layer_mask_t)(m >> (LEDS_Z - n));
+	} else {
+		a = (layer_mask_t)(m >> -n);
+		b = (layer_mask_t)(m << (LEDS_Z + n));
+	}
+	return (a | (wrap ? b : 0)) & ALL_LAYERS;
+}
+
+#if GS_DEPTH == 12 && LEDS_X % 2 == 0
+/* Voxel pairs are packed to 3 bytes, so moving along Y and Z and
+ * even steps along X are plain byte moves. Odd step along X moves
+ * the row by a nibble and a half. */
+
+#define ROW_BYTES (LEDS_X * 3 / 2)
+#define LAYER_VOXEL_BYTES (LEDS_Y * ROW_BYTES)
+
+static void reverse(uint8_t *p, uint16_t len)
+{
+	for (uint8_t *q = p + len - 1; p < q; p++, q--) {
+		const uint8_t tmp = *p;
+		*p = *q;
+		*q = tmp;
+	}
+}
+
+/* Copies len bytes from src to dst moved by k bytes towards the
+ * end, or the beginning if k is negative. Buffers may be the
+ * same. */
+static void move_bytes(uint8_t *dst, const uint8_t *src, uint16_t len,
+		       int16_t k, bool wrap)
+{
+	if (wrap) {
+		// Rolling back equals rolling forward the rest of the way
+		if (k < 0) k += len;
+		if (dst == src) {
+			reverse(dst, len);
+			reverse(dst, k);
+			reverse(dst + k, len - k);
+		} else {
+			memcpy(dst + k, src, len - k);
+			memcpy(dst, src + len - k, k);
+		}
+	} else if (k >= (int16_t)len || -k >= (int16_t)len) {
+		memset(dst, 0, len);
+	} else if (k >= 0) {
+		memmove(dst + k, src, len - k);
+		memset(dst, 0, k);
+	} else {
+		memmove(dst, src - k, len + k);
+		memset(dst + len + k, 0, -k);
+	}
+}
+
+// Moves a row by one voxel towards larger x
+static void step_right(uint8_t *row, bool wrap)
+{
+	const uint16_t v = wrap ?
+		(row[ROW_BYTES-2] & 0x0f) << 8 | row[ROW_BYTES-1] : 0;
+
+	for (uint8_t i = ROW_BYTES - 1; i >= 2; i--) {
+		row[i] = row[i-2] << 4 | row[i-1] >> 4;
+	}
+	row[1] = v << 4 | row[0] >> 4;
+	row[0] = v >> 4;
+}
+
+// Moves a row by one voxel towards smaller x
+static void step_left(uint8_t *row, bool wrap)
+{
+	const uint16_t v = wrap ? row[0] << 4 | row[1] >> 4 : 0;
+
+	for (uint8_t i = 0; i < ROW_BYTES - 2; i++) {
+		row[i] = row[i+1] << 4 | row[i+2] >> 4;
+	}
+	row[ROW_BYTES-2] = row[ROW_BYTES-1] << 4 | v >> 8;
+	row[ROW_BYTES-1] = v;
+}
+
+static void move_voxels(uint8_t axis, int8_t n, bool wrap)
+{
+	assert(axis <= AXIS_Z);
+	if (wrap) n %= (int8_t)axis_len[axis];
+
+	const uint8_t *src = gs_buf_front;
+	uint8_t *dst = gs_buf_back;
+	const layer_mask_t dirty = gs_buf_dirty(src);
+
+	switch (axis) {
+	case AXIS_X:
+		for (uint16_t r = 0; r < LEDS_Z * LEDS_Y; r++) {
+			const uint16_t layer = r / LEDS_Y * BYTES_PER_LAYER;
+			uint8_t *row = dst + layer + r % LEDS_Y * ROW_BYTES;
+
+			move_bytes(row, src + (row - dst), ROW_BYTES,
+				   n / 2 * 3, wrap);
+			if (n % 2 > 0) step_right(row, wrap);
+			if (n % 2 < 0) step_left(row, wrap);
+		}
+		gs_buf_dirty(dst) = dirty;
+		break;
+	case AXIS_Y:
+		for (uint8_t z = 0; z < LEDS_Z; z++) {
+			const uint16_t layer = z * BYTES_PER_LAYER;
+			move_bytes(dst + layer, src + layer, LAYER_VOXEL_BYTES,
+				   n * ROW_BYTES, wrap);
+		}
+		gs_buf_dirty(dst) = dirty;
+		break;
+	case AXIS_Z:
+		move_bytes(dst, src, GS_BUF_BYTES,
+			   (int16_t)n * BYTES_PER_LAYER, wrap);
+		gs_buf_dirty(dst) = move_mask(dirty, n, wrap);
+		break;
+	}
+}
+#else
+// Other geometries move one line of voxels at a time
+static void move_voxels(uint8_t axis, int8_t n, bool wrap)
+{
+	assert(axis <= AXIS_Z);
+	const uint8_t len = axis_len[axis];
+	if (wrap) n %= (int8_t)len;
+
+	// Two other axes span the lines
+	const uint8_t a = axis == AXIS_X ? AXIS_Y : AXIS_X;
+	const uint8_t b = axis == AXIS_Z ? AXIS_Y : AXIS_Z;
+	const layer_mask_t dirty = gs_buf_dirty(gs_buf_front);
+	uint16_t line[len];
+	uint8_t c[3];
+
+	for (c[a] = 0; c[a] < axis_len[a]; c[a]++) {
+		for (c[b] = 0; c[b] < axis_len[b]; c[b]++) {
+			for (c[axis] = 0; c[axis] < len; c[axis]++) {
+				line[c[axis]] = get_led(c[0], c[1], c[2]);
+			}
+			for (c[axis] = 0; c[axis] < len; c[axis]++) {
+				int16_t from = c[axis] - n;
+				if (wrap) from = (from + len) % len;
+				set_led(c[0], c[1], c[2],
+					from >= 0 && from < len ? line[from] : 0);
+			}
+		}
+	}
+
+	gs_buf_dirty(gs_buf_back) =
+		axis == AXIS_Z ? move_mask(dirty, n, wrap) : dirty;
+}
+#endif
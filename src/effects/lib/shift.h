@@ -0,0 +1,49 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_SHIFT_H
+#define EFFECT_SHIFT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+
+/* Moving the whole cube along an axis. The previous frame is taken
+ * from the front buffer and the result is written to the back
+ * buffer, so these work with both FLIP and NO_FLIP effects. Moving
+ * is done on packed data, which is much cheaper than redrawing the
+ * cube. Scrolling effects need to draw only the exposed edge. */
+
+/**
+ * Moves voxels n steps towards the larger coordinates of the axis,
+ * or towards the smaller ones if n is negative. Exposed voxels are
+ * black.
+ */
+void shift_voxels(uint8_t axis, int8_t n);
+
+/**
+ * Like shift_voxels(), but voxels moved out come back from the other
+ * side.
+ */
+void roll_voxels(uint8_t axis, int8_t n);
+
+#endif // EFFECT_SHIFT_H
@@ -0,0 +1,92 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Sparse voxel drawing
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "../../common/cube.h"
+#include "utils.h"
+#include "sparse.h"
+
+#define SPARSE_OVERFLOW (SPARSE_MAX + 1)
+
+#ifndef AVR
+bool sparse_reference = false;
+bool sparse_used = false;
+#endif
+
+void sparse_init(sparse_t *s)
+{
+	memset(s, 0, sizeof(sparse_t));
+#ifndef AVR
+	sparse_used = true;
+#endif
+}
+
+// Returns the list of the buffer or NULL if there is none
+static struct sparse_list *find_list(sparse_t *s, const uint8_t *buf)
+{
+	for (uint8_t i = 0; i < SPARSE_BUFFERS; i++) {
+		if (s->list[i].buf == buf) return s->list + i;
+	}
+	return NULL;
+}
+
+void sparse_begin(sparse_t *s)
+{
+	struct sparse_list *l = find_list(s, gs_buf_back);
+	bool clear = l == NULL;
+
+#ifndef AVR
+	if (sparse_reference) clear = true;
+#endif
+
+	if (l == NULL) {
+		// Take a free list. All taken happens only if buffers move.
+		l = find_list(s, NULL);
+		if (l == NULL) l = s->list;
+		l->buf = gs_buf_back;
+	}
+
+	if (clear || l->len == SPARSE_OVERFLOW) {
+		clear_buffer();
+	} else {
+		for (uint8_t i = 0; i < l->len; i++) {
+			set_led(l->xyz[i].x, l->xyz[i].y, l->xyz[i].z, 0);
+		}
+	}
+
+	l->len = 0;
+	s->cur = l;
+}
+
+void sparse_set(sparse_t *s, uint8_t x, uint8_t y, uint8_t z, uint16_t i)
+{
+	set_led(x, y, z, i);
+
+	struct sparse_list *l = s->cur;
+	if (l->len < SPARSE_MAX) {
+		l->xyz[l->len++] = (xyz_t){x, y, z};
+	} else {
+		l->len = SPARSE_OVERFLOW;
+	}
+}
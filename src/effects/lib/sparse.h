@@ -0,0 +1,74 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_SPARSE_H
+#define EFFECT_SPARSE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "math.h"
+
+/* Sparse drawing for effects which light only a few voxels per
+ * frame. Voxels drawn to a buffer are recorded, and next time the
+ * same buffer is drawn only those are erased instead of clearing
+ * the whole buffer. There is a list per buffer because FLIP effects
+ * draw every other frame to the same buffer. */
+
+#define SPARSE_MAX 10 // Voxels per frame before falling back to clearing
+
+#define SPARSE_BUFFERS 2
+
+struct sparse_list {
+	const uint8_t *buf; // Buffer the voxels are drawn to
+	uint8_t len;        // Number of voxels, SPARSE_MAX+1 if too many
+	xyz_t xyz[SPARSE_MAX];
+};
+
+/* Keep this in vars of the effect to share the memory with other
+ * effects */
+typedef struct {
+	struct sparse_list list[SPARSE_BUFFERS];
+	struct sparse_list *cur; // List of the back buffer
+} sparse_t;
+
+/**
+ * Forgets the recorded voxels. Call in init.
+ */
+void sparse_init(sparse_t *s);
+
+/**
+ * Erases voxels drawn to the back buffer last time. Use this
+ * instead of clear_buffer() in the beginning of a frame.
+ */
+void sparse_begin(sparse_t *s);
+
+/**
+ * Sets voxel intensity like set_led() and records the voxel.
+ */
+void sparse_set(sparse_t *s, uint8_t x, uint8_t y, uint8_t z, uint16_t i);
+
+#ifndef AVR
+/* Benchmarking aids for exporter. When sparse_reference is set, the
+ * back buffer is cleared as a whole. sparse_used is set when an effect
+ * initializes its voxel lists. */
+extern bool sparse_reference;
+extern bool sparse_used;
+#endif
+
+#endif // EFFECT_SPARSE_H
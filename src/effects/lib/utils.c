@@ -29,10 +29,6 @@
 #include "../../common/cube.h"
 #include "utils.h"
 
-/* If you are changing LED count make sure you are not using set_led
-   which is optimized to work only 12-bit depths and when y and z
-   dimensions have length of 8. */
-
 /* ticks is set to ticks_volatile every time when frame calculation is
  * started. This keeps ticks stable and removes tearing. */
 uint16_t ticks;
@@ -45,8 +41,146 @@ sensors_t sensors = {MAX_INTENSITY};
 
 void set_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2, uint16_t intensity)
 {
-	for(uint8_t i = y1; i <= y2; i++) {
-		set_led_8_8_12(x, i, z, intensity);
+	fill_y_row(x, z, y1, y2, intensity);
+}
+
+#if GS_DEPTH == 12 && LEDS_X % 2 == 0
+/* The fill functions below expect the same buffer layout as
+ * set_led_8_8_12(): voxels next to each other on X axis are packed
+ * in pairs to 3 bytes, first voxel of a pair being the one with even
+ * x. */
+
+// Stores intensity to the first voxel of a pair
+static inline void put_even(uint8_t *p, uint16_t i)
+{
+	p[0] = i >> 4;
+	p[1] = (p[1] & 0x0f) | (i << 4);
+}
+
+// Stores intensity to the second voxel of a pair
+static inline void put_odd(uint8_t *p, uint16_t i)
+{
+	p[1] = (p[1] & 0xf0) | (i >> 8);
+	p[2] = i;
+}
+
+// Stores intensity to given number of voxel pairs
+static void fill_pairs(uint8_t *p, uint8_t pairs, uint16_t i)
+{
+	const uint8_t a = i >> 4;
+	const uint8_t b = (i << 4) | (i >> 8);
+	const uint8_t c = i;
+
+	// Black and full intensity are just repeating bytes
+	if (a == b && b == c) {
+		memset(p, a, 3 * pairs);
+		return;
+	}
+
+	while (pairs--) {
+		*p++ = a;
+		*p++ = b;
+		*p++ = c;
+	}
+}
+
+void fill_x_row(uint8_t y, uint8_t z, uint8_t x1, uint8_t x2, uint16_t i)
+{
+	assert(x1 <= x2);
+	assert(x2 < LEDS_X);
+	assert(y < LEDS_Y);
+	assert(z < LEDS_Z);
+	assert(i < (1 << GS_DEPTH));
+
+	mark_dirty(gs_buf_back, z);
+	uint8_t *p = gs_buf_back + z * BYTES_PER_LAYER + y * (LEDS_X * 3 / 2) +
+		(x1 >> 1) * 3;
+
+	// Odd start voxel shares its bytes with a voxel outside the row
+	if (x1 & 1) {
+		put_odd(p, i);
+		p += 3;
+		x1++;
+	}
+
+	const uint8_t n = x2 + 1 - x1;
+	fill_pairs(p, n >> 1, i);
+
+	// So does an even end voxel
+	if (n & 1) put_even(p + 3 * (n >> 1), i);
+}
+
+void fill_y_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2, uint16_t i)
+{
+	assert(y1 <= y2);
+	assert(x < LEDS_X);
+	assert(y2 < LEDS_Y);
+	assert(z < LEDS_Z);
+	assert(i < (1 << GS_DEPTH));
+
+	/* Voxels on a Y row are in the same half of a pair, one row
+	 * length apart, so the byte position needs to be calculated
+	 * only once. */
+	mark_dirty(gs_buf_back, z);
+	uint8_t *p = gs_buf_back + z * BYTES_PER_LAYER + y1 * (LEDS_X * 3 / 2) +
+		(x >> 1) * 3;
+	uint8_t n = y2 - y1 + 1;
+
+	if (x & 1) {
+		for (; n; n--, p += LEDS_X * 3 / 2) put_odd(p, i);
+	} else {
+		for (; n; n--, p += LEDS_X * 3 / 2) put_even(p, i);
+	}
+}
+
+void fill_xy_plane(uint8_t z, uint16_t i)
+{
+	assert(z < LEDS_Z);
+	assert(i < (1 << GS_DEPTH));
+
+	fill_pairs(gs_buf_back + z * BYTES_PER_LAYER, LEDS_X * LEDS_Y / 2, i);
+
+	// Black layer is clean again
+	if (i) mark_dirty(gs_buf_back, z);
+	else gs_buf_dirty(gs_buf_back) &= ~((layer_mask_t)1 << z);
+}
+#else
+/* Other geometries have no voxel pairs, so just plot the voxels */
+void fill_x_row(uint8_t y, uint8_t z, uint8_t x1, uint8_t x2, uint16_t i)
+{
+	for (uint8_t x = x1; x <= x2; x++) set_led(x, y, z, i);
+}
+
+void fill_y_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2, uint16_t i)
+{
+	for (uint8_t y = y1; y <= y2; y++) set_led(x, y, z, i);
+}
+
+void fill_xy_plane(uint8_t z, uint16_t i)
+{
+	for (uint8_t y = 0; y < LEDS_Y; y++) {
+		fill_x_row(y, z, 0, LEDS_X-1, i);
+	}
+
+	// Black layer is clean again
+	if (!i) gs_buf_dirty(gs_buf_back) &= ~((layer_mask_t)1 << z);
+}
+#endif
+
+void fill_xz_plane(uint8_t y, uint16_t i)
+{
+	for (uint8_t z = 0; z < LEDS_Z; z++) {
+		fill_x_row(y, z, 0, LEDS_X-1, i);
+	}
+}
+
+void fill_box(uint8_t x1, uint8_t y1, uint8_t z1,
+	      uint8_t x2, uint8_t y2, uint8_t z2, uint16_t i)
+{
+	for (uint8_t z = z1; z <= z2; z++) {
+		for (uint8_t y = y1; y <= y2; y++) {
+			fill_x_row(y, z, x1, x2, i);
+		}
 	}
 }
 
@@ -59,10 +193,13 @@ void set_z(uint8_t x, uint8_t y, uint16_t intensity)
 	uint16_t upper_i = intensity & MAX_INTENSITY;
 	uint16_t lower_i = MAX_INTENSITY - upper_i;
 	
-	set_led_8_8_12(x,y,lower_z,lower_i);
-	set_led_8_8_12(x,y,lower_z + 1,upper_i);
+	set_led(x,y,lower_z,lower_i);
+	set_led(x,y,lower_z + 1,upper_i);
 }
 
+/* Hand-optimized implementation of hardware geometry. Other
+ * geometries are generated to src/generated/geometry.c */
+#if LEDS_X == 8 && LEDS_Y == 8 && GS_DEPTH == 12 && BYTES_PER_LAYER == 96 && !defined(VOXEL_LUT)
 void set_led_8_8_12(uint8_t x, uint8_t y, uint8_t z, uint16_t i)
 {
 	/* Assert (on testing environment) that we supply correct
@@ -72,13 +209,6 @@ void set_led_8_8_12(uint8_t x, uint8_t y, uint8_t z, uint16_t i)
 	assert(z < LEDS_Z);
 	assert(i < (1 << GS_DEPTH));
 
-#ifdef MIRROR_X
-	x = 7-x;
-#endif
-#ifdef MIRROR_Y
-	y = 7-y;
-#endif
-
 	/* Cube buffers are bit packed: 2 voxels per 3 bytes when
 	 * GS_DEPTH is 12. This calculates bit position efficiently by
 	 * using bit shifts. With AVR's 8-bit registers this is
@@ -102,7 +232,9 @@ void set_led_8_8_12(uint8_t x, uint8_t y, uint8_t z, uint16_t i)
 	/* Store data back to buffer */
 	gs_buf_back[byte_pos] = raw >> 8;
 	gs_buf_back[byte_pos+1] = raw;
+	mark_dirty(gs_buf_back, z);
 }
+#endif
 
 uint16_t get_led_wrap(int8_t x, int8_t y, int8_t z)
 {
@@ -123,6 +255,7 @@ uint16_t get_led_wrap(int8_t x, int8_t y, int8_t z)
 	return get_led(rx, ry, rz);
 }
 
+#if LEDS_X == 8 && LEDS_Y == 8 && GS_DEPTH == 12 && BYTES_PER_LAYER == 96 && !defined(VOXEL_LUT)
 uint16_t get_led_8_8_12(uint8_t x, uint8_t y, uint8_t z)
 {
 	/* Assert (on testing environment) that we supply correct
@@ -150,6 +283,7 @@ uint16_t get_led_8_8_12(uint8_t x, uint8_t y, uint8_t z)
 	 * MSB, otherwise we get from MSB - 4 bits. */
 	return (bit_pos & 0x7) ? raw & 0x0fff : raw >> 4;
 }
+#endif
 
 void iterate_xy(iterate_xy_t f)
 {
@@ -173,5 +307,12 @@ void iterate_xyz(iterate_xyz_t f)
 
 void clear_buffer(void)
 {
-	memset(gs_buf_back,0,GS_BUF_BYTES);
+	layer_mask_t dirty = gs_buf_dirty(gs_buf_back);
+	uint8_t *p = gs_buf_back;
+
+	// Layers not marked dirty are black already
+	for (; dirty; dirty >>= 1, p += BYTES_PER_LAYER) {
+		if (dirty & 1) memset(p, 0, BYTES_PER_LAYER);
+	}
+	gs_buf_dirty(gs_buf_back) = 0;
 }
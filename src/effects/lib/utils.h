@@ -23,14 +23,10 @@
 #include <stdbool.h>
 #include "../../common/env.h"
 
-/* Defining set_led() as a macro which chooses the most efficient
- * implementation available */
-#if LEDS_X == 8 && LEDS_Y == 8 && GS_DEPTH == 12 && BYTES_PER_LAYER == 96
-#define set_led(x,y,z,i) set_led_8_8_12(x,y,z,i)
-#define get_led(x,y,z) get_led_8_8_12(x,y,z)
-#else
-#error "There is no set_led() implementation for this geometry"
-#endif
+/* Defines set_led() and get_led() as macros which choose the
+ * implementation generated for the current geometry by
+ * generators/geometry.py */
+#include "../../generated/geometry.h"
 
 /* Maximum intensity returned from the 2D plotting function */
 #define MAX_2D_PLOT_INTENSITY ((LEDS_Z-1)*(1 << GS_DEPTH)-1)
@@ -66,10 +62,15 @@ typedef struct {
 	uint8_t flip_buffers;  // Flip buffers during execution.
 	uint8_t minimum_ticks; // Minimum amount of ticks per draw.
 	bool dynamic_text;     // Contains dynamic custom data?
+	bool palette;          // Draws palette indices, see output.h
+	bool tween;            // Interpolated between frames, see output.h
+	bool dither;           // Draws dithered levels, see output.h
+	bool feedback;         // Reads the previous frame from front
 } effect_t;
 
 #define NO_FLIP 0
 #define FLIP 1
+#define JIT 2 // Flip or render layers just in time when supported
 
 typedef struct {
 	uint16_t debug_value; // Settable via serial port only. TODO: to be removed
@@ -87,6 +88,34 @@ typedef struct {
  */
 void set_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2, uint16_t intensity);
 
+/**
+ * Sets voxels x1..x2 on row y, z to given intensity. Voxel pairs are
+ * written at once.
+ */
+void fill_x_row(uint8_t y, uint8_t z, uint8_t x1, uint8_t x2, uint16_t i);
+
+/**
+ * Sets voxels y1..y2 on row x, z to given intensity.
+ */
+void fill_y_row(uint8_t x, uint8_t z, uint8_t y1, uint8_t y2, uint16_t i);
+
+/**
+ * Sets whole layer z to given intensity.
+ */
+void fill_xy_plane(uint8_t z, uint16_t i);
+
+/**
+ * Sets all voxels having given y to given intensity.
+ */
+void fill_xz_plane(uint8_t y, uint16_t i);
+
+/**
+ * Sets all voxels inside the box, including the edges, to given
+ * intensity. The first corner must have the smaller coordinates.
+ */
+void fill_box(uint8_t x1, uint8_t y1, uint8_t z1,
+	      uint8_t x2, uint8_t y2, uint8_t z2, uint16_t i);
+
 /**
  * Do linear interpolation and set z coordinate accordingly. Intensity
  * must be between 0 and MAX_2D_PLOT_INTENSITY, inclusively.
@@ -97,7 +126,8 @@ void set_z(uint8_t x, uint8_t y, uint16_t intensity);
  * Sets led intensity. i is the intensity of the LED in range
  * 0..4095. This implementation is AVR optimized and handles only
  * cases where LEDS_X and LEDS_Y are 8, GS_DEPTH is 12, and layer has
- * no padding. Do not call directly, use set_led() instead.
+ * no padding. Do not call directly, use set_led() instead. Other
+ * geometries have generated implementations.
  */
 void set_led_8_8_12(uint8_t x, uint8_t y, uint8_t z, uint16_t i);
 
@@ -130,7 +160,8 @@ typedef void(*iterate_xyz_t)(uint8_t,uint8_t,uint8_t);
 void iterate_xyz(iterate_xyz_t f);
 
 /**
- * Sets all voxels in back buffer as black
+ * Sets all voxels in back buffer as black. Only the layers marked
+ * dirty are cleared.
  */
 void clear_buffer(void);
 
@@ -18,11 +18,24 @@
  */
 
 #include <stdint.h>
+#include "../../common/env.h"
 #include "../../common/pgmspace.h"
 
-/* Pre-calculated Weber–Fechner table generated by helpers/WeberFechner.hs */
+/* Pre-calculated Weber–Fechner tables generated by helpers/WeberFechner.hs */
 const uint16_t weber_fechner_table[] PROGMEM = {0,0,0,0,0,0,0,0,0,0,0,0,0,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,12,12,12,12,12,12,12,12,12,12,13,13,13,13,13,13,13,13,14,14,14,14,14,14,15,15,15,15,15,16,16,16,16,17,17,17,17,18,18,18,18,19,19,19,20,20,21,21,21,22,22,23,23,23,24,24,25,26,26,27,27,28,28,29,30,30,31,32,33,33,34,35,36,37,38,39,40,41,42,43,44,45,46,48,49,50,52,53,54,56,57,59,61,62,64,66,68,70,72,74,76,78,81,83,85,88,91,93,96,99,102,105,108,112,115,118,122,126,130,134,138,142,147,151,156,161,166,171,176,182,188,193,200,206,212,219,226,233,241,248,256,265,273,282,291,300,310,320,330,341,352,363,375,387,400,412,426,440,454,469,484,500,516,533,550,568,587,606,625,646,667,689,711,735,759,784,809,836,863,891,921,951,982,1014,1048,1082,1118,1154,1192,1232,1272,1314,1357,1402,1448,1496,1545,1596,1649,1703,1759,1817,1877,1939,2003,2069,2137,2208,2281,2356,2434,2514,2597,2683,2772,2863,2958,3056,3157,3261,3369,3480,3595,3714,3837,3964,4095};
 
+// Same curve in 14 bits for temporal dithering
+const uint16_t weber_fechner_fine_table[] PROGMEM = {0,0,0,0,0,0,0,0,0,0,0,41,41,41,41,41,41,41,41,41,41,41,41,41,41,42,42,42,42,42,42,42,42,43,43,43,43,43,43,43,44,44,44,44,44,45,45,45,45,45,46,46,46,47,47,47,47,48,48,48,49,49,50,50,50,51,51,52,52,53,53,54,54,55,56,56,57,58,58,59,60,61,62,63,63,64,65,66,67,69,70,71,72,73,75,76,78,79,81,82,84,86,87,89,91,93,95,98,100,102,105,107,110,113,115,118,122,125,128,132,135,139,143,147,151,155,160,164,169,174,180,185,191,197,203,209,216,223,230,237,245,253,261,270,279,288,297,307,318,329,340,352,364,376,389,403,417,432,447,463,479,496,514,532,552,571,592,614,636,659,683,708,734,761,789,818,848,880,912,946,981,1018,1056,1095,1136,1179,1223,1269,1316,1366,1417,1471,1526,1584,1644,1706,1771,1838,1908,1980,2055,2134,2215,2299,2387,2478,2573,2671,2773,2879,2989,3103,3222,3346,3474,3607,3745,3889,4039,4194,4355,4522,4696,4877,5064,5259,5461,5672,5890,6117,6353,6598,6852,7116,7390,7676,7972,8279,8599,8931,9276,9634,10006,10392,10794,11211,11644,12094,12562,13047,13552,14076,14620,15186,15773,16383};
+
 uint16_t weber_fechner(uint8_t i) {
-	return pgm_get(weber_fechner_table[i],word);
+	// Table is calculated for 12-bit depth
+#if GS_DEPTH < 12
+	return pgm_get(weber_fechner_table[i],word) >> (12 - GS_DEPTH);
+#else
+	return pgm_get(weber_fechner_table[i],word) << (GS_DEPTH - 12);
+#endif
+}
+
+uint16_t weber_fechner_fine(uint8_t i) {
+	return pgm_get(weber_fechner_fine_table[i],word);
 }
@@ -24,3 +24,11 @@
  * Converts values from human perception range to PWM cycle length.
  */
 uint16_t weber_fechner(uint8_t i);
+
+#define WEBER_FECHNER_FINE_BITS 14
+
+/**
+ * Converts values from human perception range to PWM cycle length
+ * with WEBER_FECHNER_FINE_BITS of precision. Used for dithering.
+ */
+uint16_t weber_fechner_fine(uint8_t i);
@@ -18,41 +18,54 @@
  */
 
 #pragma FLIP
+#pragma FEEDBACK
 
 #include "common.h"
 
+/* Drops fall one layer per frame. The cube is shifted down and only
+ * the drops starting again from the top are drawn. */
+
 struct {
 	xyz_t xyz[10];
 } vars;
 
 static const uint8_t matrix_xyz_len = 10;
 
+static const uint8_t drop_len = 3;
+
+// Draws the part of the drop starting at z which fits in the cube
+static void drop(xyz_t xyz, uint8_t z)
+{
+	for(uint8_t j = 0; j < drop_len && z + j < LEDS_Z; j++) {
+		set_led(xyz.x, xyz.y, z + j, MAX_INTENSITY);
+	}
+}
+
 void init(void)
 {
+	clear_buffer();
+
 	for(uint8_t i = 0; i < matrix_xyz_len; i++) {
 		vars.xyz[i] = (xyz_t){
 			.x = randint(0, LEDS_X),
 			.y = randint(0, LEDS_Y),
 			.z = randint(0, LEDS_Z)
 		};
-	}
 
-	clear_buffer();
+		// One layer up, the first frame shifts it in place
+		if(vars.xyz[i].z > 0) drop(vars.xyz[i], vars.xyz[i].z - 1);
+	}
 }
+
 void effect(void)
 {
-	clear_buffer();
+	shift_voxels(AXIS_Z, 1);
 
 	for(uint8_t i = 0; i < matrix_xyz_len; i++) {
-		xyz_t xyz = vars.xyz[i];
-
-		for(uint8_t j = 0; j < 3; j++) {
-			if(xyz.z + j < LEDS_Z) {
-				set_led(xyz.x, xyz.y, xyz.z + j, MAX_INTENSITY);
-			}
-		}
+		// Drops which fell out start again from the top
+		if(vars.xyz[i].z == 0) drop(vars.xyz[i], 0);
 
-		uint8_t z = xyz.z;
+		uint8_t z = vars.xyz[i].z;
 
 		z++;
 
@@ -21,6 +21,7 @@
 
 struct {
 	xyz_t xyz[5];
+	sparse_t sparse;
 } vars;
 
 static const uint8_t xyz_len = 5;
@@ -37,18 +38,19 @@ void init(void)
 		vars.xyz[i] = p;
 	}
 
+	sparse_init(&vars.sparse);
 	clear_buffer();
 }
 void effect(void)
 {
 	if(ticks % 50) return;
 
-	clear_buffer();
+	sparse_begin(&vars.sparse);
 
 	for(uint8_t i = 0; i < xyz_len; i++) {
 		xyz_t p = vars.xyz[i];
 
-		set_led(p.x, p.y, p.z, MAX_INTENSITY);
+		sparse_set(&vars.sparse, p.x, p.y, p.z, MAX_INTENSITY);
 
 		p.x = clamp(p.x + randint(-1, 1), 0, LEDS_X - 1);
 		p.y = clamp(p.y + randint(-1, 1), 0, LEDS_Y - 1);
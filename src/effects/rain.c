@@ -46,16 +46,8 @@ void effect(void)
 	const uint8_t surface = ticks & 127;
 
 	for (uint8_t z=0; z<water; z++) {
-		for (uint8_t x=0; x<8; x++) {
-			for (uint8_t y=0; y<8; y++) {
-				set_led(x,y,7-z, MAX_INTENSITY);
-			}
-		}
+		fill_xy_plane(7-z, MAX_INTENSITY);
 	}
 
-	for (uint8_t x=0; x<8; x++) {
-		for (uint8_t y=0; y<8; y++) {
-			set_led(x,y,8-water, weber_fechner(surface << 1));
-		}
-	}
+	fill_xy_plane(8-water, weber_fechner(surface << 1));
 }
@@ -19,6 +19,7 @@
 
 # pragma FLIP
 # pragma DYNAMIC_TEXT
+# pragma OVERLAY
 
 #include "common.h"
 
@@ -47,10 +48,13 @@ void init(void)
 
 void effect(void)
 {
-	clear_buffer();
+	bitplane_t plane;
+	bitplane_use(plane);
+	bitplane_clear();
 	// Slow down scrolling speed and wrap to beginning if needed
 	int16_t pos = (ticks >> 3) % vars.width;
-	scroll_text(vars.data, vars.mem, pos, render_xy);
-	scroll_text(vars.data, vars.mem, pos-7, render_yz);
+	scroll_text(vars.data, vars.mem, pos, bit_render_xy);
+	scroll_text(vars.data, vars.mem, pos-7, bit_render_yz);
+	bitplane_expand(MAX_INTENSITY);
 }
 
@@ -18,14 +18,14 @@
  */
 
 # pragma FLIP
+# pragma JIT
+# pragma OVERLAY
 
 #include "common.h"
 
-void effect(void)
+CANVAS(effect)
 {
 	float fac = (float)((ticks >> 3) % 10) / 10;
 
-	clear_buffer();
-
-	sphere_shape(-3, -3, -3, 10, 14, fac);
+	sphere_layer(canvas, z, -3, -3, -3, 10, 14, fac);
 }
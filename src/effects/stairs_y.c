@@ -26,7 +26,7 @@ void init(void)
 	clear_buffer();
 	for(uint8_t x = 0; x<LEDS_X; x++) {
 		for(uint8_t y=0; y<LEDS_Y; y++) {
-			set_led_8_8_12(x, y, y, MAX_INTENSITY);
+			set_led(x, y, y, MAX_INTENSITY);
 		}
 	}
 }
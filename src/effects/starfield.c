@@ -21,6 +21,7 @@
 
 struct {
 	xyz_t xyz[10];
+	sparse_t sparse;
 } vars;
 
 static const uint8_t starfield_xyz_len = 10;
@@ -35,16 +36,18 @@ void init(void)
 		};
 	}
 
+	sparse_init(&vars.sparse);
 	clear_buffer();
 }
 void effect(void)
 {
-	clear_buffer();
+	// Only the stars of the previous frame are erased
+	sparse_begin(&vars.sparse);
 
 	for(uint8_t i = 0; i < starfield_xyz_len; i++) {
 		xyz_t xyz = vars.xyz[i];
 
-		set_led(xyz.x, xyz.y, xyz.z, MAX_INTENSITY);
+		sparse_set(&vars.sparse, xyz.x, xyz.y, xyz.z, MAX_INTENSITY);
 
 		uint8_t y = xyz.y;
 
@@ -22,16 +22,21 @@
 #include "common.h"
 
 void effect(void) {
+	bitplane_t plane;
+
 	int8_t fac = (ticks >> 4) % 2;
 
-	clear_buffer();
+	bitplane_use(plane);
+	bitplane_clear();
+
+	circle_bits(fac, 0, 0, 9, 13);
+	circle_bits(-fac, 0, 1, 8, 12);
+	circle_bits(0, fac, 2, 7, 11);
+	circle_bits(0, -fac, 3, 7, 10);
+	circle_bits(fac, 0, 4, 6, 9);
+	circle_bits(-fac, 0, 5, 3, 5);
+	circle_bits(0, fac, 6, 1, 3);
+	bit_set(fac, 4, 7);
 
-	circle_shape(fac, 0, 0, 9, 13, MAX_INTENSITY);
-	circle_shape(-fac, 0, 1, 8, 12, MAX_INTENSITY);
-	circle_shape(0, fac, 2, 7, 11, MAX_INTENSITY);
-	circle_shape(0, -fac, 3, 7, 10, MAX_INTENSITY);
-	circle_shape(fac, 0, 4, 6, 9, MAX_INTENSITY);
-	circle_shape(-fac, 0, 5, 3, 5, MAX_INTENSITY);
-	circle_shape(0, fac, 6, 1, 3, MAX_INTENSITY);
-	set_led(fac, 4, 7, MAX_INTENSITY);
+	bitplane_expand(MAX_INTENSITY);
 }
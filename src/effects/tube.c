@@ -22,7 +22,10 @@
 #include "common.h"
 
 void effect(void) {
-	clear_buffer();
+	bitplane_t plane;
+	bitplane_use(plane);
+	bitplane_clear();
 
-	circle_shape(0, 0, (ticks >> 2) % LEDS_Z, 6, 10, MAX_INTENSITY);
+	circle_bits(0, 0, (ticks >> 2) % LEDS_Z, 6, 10);
+	bitplane_expand(MAX_INTENSITY);
 }
@@ -0,0 +1,142 @@
+/* -*- mode: c; c-file-style: "linux" -*-
+ *  vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ *
+ *  Copyright 2012 Elovalo project group 
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Drawing path benchmark for non-embedded use.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../effects/lib/utils.h"
+#include "../effects/lib/canvas.h"
+#include "../effects/lib/sparse.h"
+#include "../common/effects.h"
+#include "../common/cube.h"
+#include "benchmark.h"
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Draws given amount of frames and returns the average drawing time
+ * of a frame in microseconds. Buffer contents of the last frame are
+ * copied to last_frame.
+ */
+static double run_effect(const effect_t *effect, int frames,
+			 uint8_t *last_frame)
+{
+	// Both paths must see the same random numbers
+	srand(1);
+	custom_data = NULL;
+	memset(gs_buf_front, 0, GS_BUF_BYTES);
+	memset(gs_buf_back, 0, GS_BUF_BYTES);
+	gs_buf_dirty(gs_buf_front) = 0;
+	gs_buf_dirty(gs_buf_back) = 0;
+
+	if (effect->init != NULL) {
+		effect->init();
+		gs_buf_swap();
+	}
+
+	double total = 0;
+	ticks = 0;
+	for (int i = 0; i < frames; i++, ticks += effect->minimum_ticks) {
+		double start = now();
+		effect->draw();
+		total += now() - start;
+		gs_buf_swap();
+	}
+
+	memcpy(last_frame, gs_buf_front, GS_BUF_BYTES);
+	return total / frames * 1e6;
+}
+
+/* Optimized drawing path and its traditional reference. Setting
+ * reference flag selects the traditional path and used flag tells
+ * if the effect took the optimized path at all. */
+struct path {
+	const char *name;
+	const char *reference_name;
+	bool *reference;
+	bool *used;
+};
+
+static const struct path paths[] = {
+	{"canvas", "set_led", &canvas_reference, &canvas_used},
+	{"sparse", "clear", &sparse_reference, &sparse_used},
+};
+
+/**
+ * Tells if init of the effect already selects the path. Effects not
+ * flipping are benchmarked only then because some of them are not
+ * safe to run for long.
+ */
+static bool probe(const effect_t *effect, const struct path *path)
+{
+	custom_data = NULL;
+	if (effect->init != NULL) effect->init();
+	return *path->used;
+}
+
+void benchmark_effects(int frames)
+{
+	uint8_t optimized[GS_BUF_BYTES];
+	uint8_t reference[GS_BUF_BYTES];
+	char title[2][20];
+
+	for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+		const struct path *path = paths + p;
+
+		snprintf(title[0], sizeof(title[0]), "%s [us]",
+			 path->reference_name);
+		snprintf(title[1], sizeof(title[1]), "%s [us]", path->name);
+		printf("%s%-16s %12s %12s %8s\n", p ? "\n" : "", "effect",
+		       title[0], title[1], "speedup");
+
+		for (int i = 0; i < effects_len; i++) {
+			const effect_t *effect = &effects[i];
+
+			/* Only effects using the path can be compared */
+			if (effect->draw == NULL) continue;
+			*path->used = false;
+			*path->reference = false;
+			if (!effect->flip_buffers && !probe(effect, path))
+				continue;
+			double t_opt = run_effect(effect, frames, optimized);
+			if (!*path->used) continue;
+
+			*path->reference = true;
+			double t_ref = run_effect(effect, frames, reference);
+			*path->reference = false;
+
+			printf("%-16s %12.2f %12.2f %7.2fx%s\n", effect->name,
+			       t_ref, t_opt, t_ref / t_opt,
+			       memcmp(optimized, reference, GS_BUF_BYTES) ?
+			       " MISMATCH" : "");
+		}
+	}
+}
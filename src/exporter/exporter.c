@@ -29,9 +29,12 @@
 #include <string.h>
 #include <sys/stat.h>
 #include "../effects/lib/utils.h"
+#include "../effects/lib/blend.h"
 #include "../common/effect_utils.h"
 #include "../common/cube.h"
+#include "../common/output.h"
 #include "../effects/lib/font8x8.h"
+#include "benchmark.h"
 
 void export_effect(const effect_t *effect, double length, const char *sensor_path,
 		   const char *data, bool binary);
@@ -42,6 +45,29 @@ void export_effect(const effect_t *effect, double length, const char *sensor_pat
  */
 struct glyph_buf *convert_to_glyphs(const char *text);
 
+// Next layer to render in JIT mode
+static uint8_t jit_z;
+
+// Effect drawn on top of the exported one, like in playlists
+static struct {
+	const effect_t *effect; // NULL if none
+	uint8_t blend;
+	uint8_t alpha;
+} overlay;
+
+static const char *blend_names[BLEND_MODES] = {
+	"none", "add", "max", "multiply", "alpha", "mix"
+};
+
+/**
+ * Parses overlay argument of format name[:mode[:alpha]]. Returns
+ * false on error.
+ */
+static bool parse_overlay(char *arg);
+
+// Front buffer after the output stage
+static struct gs_buf expanded;
+
 int main(int argc, char **argv) {
 	bool binary = false;
 	const char* prog = argv[0];
@@ -51,7 +77,12 @@ int main(int argc, char **argv) {
 	/* TODO use GNU getopt or similar to parse the output of
 	 * this. Now this is quite a hack. */
 
-	if (argc > 0) {
+	if (argc > 1) {
+		if (strcmp("--benchmark",argv[1]) == 0) {
+			// Compare drawing paths instead of exporting
+			benchmark_effects(argc > 2 ? atoi(argv[2]) : 1000);
+			return 0;
+		}
 		if (strcmp("--binary",argv[1]) == 0 ||
 		    strcmp("-b",argv[1]) == 0)
 		{
@@ -62,11 +93,22 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	if (argc > 2 && (strcmp("--overlay",argv[1]) == 0 ||
+			 strcmp("-o",argv[1]) == 0))
+	{
+		// Stack an overlay and shift arguments by two
+		if (!parse_overlay(argv[2])) return 1;
+		argc -= 2;
+		argv += 2;
+	}
+
 	// TODO: figure out what should happen if an effect is not found by name
 	if(argc < 3) {
 		fprintf(stderr,"Missing effect and length arguments!\n\n"
-			"Usage: %s [-b|--binary] name [length] [sensor_file] "
-			"[custom_data]\n",prog);
+			"Usage: %s [-b|--binary] [-o|--overlay "
+			"name[:mode[:alpha]]] name [length] [sensor_file] "
+			"[custom_data]\n"
+			"       %s --benchmark [frames]\n",prog,prog);
 	}
 	else if(argc == 3) export_effect(find_effect(argv[1]), atof(argv[2]),
 					 "", NULL, binary);
@@ -76,16 +118,49 @@ int main(int argc, char **argv) {
 					 argv[3], argv[4], binary);
 }
 
+static bool parse_overlay(char *arg)
+{
+	const char *name = strtok(arg, ":");
+	const char *mode = strtok(NULL, ":");
+	const char *alpha = strtok(NULL, ":");
+
+	overlay.effect = find_effect(name);
+	overlay.blend = BLEND_ALPHA;
+	overlay.alpha = alpha == NULL ? 255 : atoi(alpha);
+
+	if (mode != NULL) {
+		for (overlay.blend = 0; overlay.blend < BLEND_MODES;
+		     overlay.blend++) {
+			if (strcmp(mode, blend_names[overlay.blend]) == 0) break;
+		}
+	}
+
+	if (overlay.effect == NULL || overlay.effect->draw == NULL ||
+	    overlay.blend == BLEND_MODES) {
+		fprintf(stderr,"Invalid overlay or blend mode\n");
+		return false;
+	}
+	return true;
+}
+
 void export_effect(const effect_t *effect, double length, const char *sensor_path, const char *data, bool binary) {
 	const int size = 50;
 	char filename[size];
 	uint8_t use_sensors = strlen(sensor_path) > 0;
+	char black_layer[LEDS_X*LEDS_Y*9+1];
 
 	json_t *distance1;
 	json_t *distance2;
 	json_t *ambient_light;
 	json_t *sound_pressure_level;
 
+	// Same restrictions as in playlists
+	if (overlay.effect != NULL && (!effect->flip_buffers || effect->palette ||
+				       effect->dither || effect->feedback)) {
+		fprintf(stderr,"%s can not have an overlay\n", effect->name);
+		return;
+	}
+
 	if (data == NULL) {
 		custom_data = NULL;
 	} else {
@@ -122,11 +197,16 @@ void export_effect(const effect_t *effect, double length, const char *sensor_pat
 
 	/* Increment frame counter at the rate desired by the
 	   effect. However, limit it to 25 fps to keep it compatible
-	   with the serial port speed. 5 * 8 ms (25 fps) */
-	const uint16_t drawing_time = effect->minimum_ticks < 5 ? 5 : effect->minimum_ticks;
+	   with the serial port speed. 5 * 8 ms (25 fps). Interpolated
+	   effects are exported at that rate, too. */
+	const uint16_t drawing_time =
+		effect->minimum_ticks < 5 || effect->tween ? 5 :
+		effect->minimum_ticks;
 	const uint8_t fps = 125/drawing_time;
 	
-	int bytes = snprintf(filename, size, "exports/%s.%s", effect->name, 
+	int bytes = snprintf(filename, size, "exports/%s%s%s.%s", effect->name,
+			     overlay.effect ? "+" : "",
+			     overlay.effect ? overlay.effect->name : "",
 			     binary ? "elo" : "json");
 	assert(bytes <= size);
 
@@ -141,6 +221,11 @@ void export_effect(const effect_t *effect, double length, const char *sensor_pat
 		return;
 	}
 
+	/* Layers are collected to front buffer when rendering just in
+	 * time. Overlays need the whole frame. */
+	const bool jit = effect->flip_buffers == JIT && JIT_SUPPORTED &&
+		overlay.effect == NULL;
+
 	/* If not flipping buffers, front must equal to back to
 	 * support simultaneous drawing of front buffer */
 	uint8_t *old_front = NULL;
@@ -149,11 +234,26 @@ void export_effect(const effect_t *effect, double length, const char *sensor_pat
 		gs_buf_front = gs_buf_back;
 	}
 
+	const uint8_t format = effect->palette ? OUTPUT_PALETTE :
+		effect->dither ? OUTPUT_LEVEL : OUTPUT_DIRECT;
+	memset(palette, 0, sizeof(palette));
+	gs_buf_set_format(gs_buf_back, format);
+
+	if (overlay.effect != NULL && overlay.effect->init != NULL) {
+		overlay.effect->init();
+	}
 	if (effect->init != NULL) {
 		effect->init();
 		gs_buf_swap(); /* Flip to bring initialized data
 				* accessible by get_led() */
 	}
+	gs_buf_set_format(gs_buf_back, format);
+
+	if (jit) {
+		gs_buf_dirty(gs_buf_front) = ALL_LAYERS;
+		jit_z = 0;
+		jit_active = true;
+	}
 
 	// TODO handle errors on file operations!
 
@@ -167,8 +267,18 @@ void export_effect(const effect_t *effect, double length, const char *sensor_pat
 		// Draw the frames
 		fprintf(f,"{\"fps\":%d,\"geometry\":[%d,%d,%d],\"frames\":[[",
 			fps,LEDS_X,LEDS_Y,LEDS_Z);
+
+		// Prepare output of a black layer
+		char *p = black_layer;
+		for (int j=0; j<LEDS_X*LEDS_Y; j++) {
+			p += sprintf(p,"%f,",0.0);
+		}
 	}
 
+	// Interpolated effects draw at their own rate
+	uint16_t next_draw_at = 0;
+	tween_from = NULL;
+
 	int i;
 	for (i = 0, ticks = 0; i < (int)(fps*length); ticks += drawing_time, i++) {
 		if(use_sensors) {
@@ -178,35 +288,73 @@ void export_effect(const effect_t *effect, double length, const char *sensor_pat
 			sensors.sound_pressure_level = json_integer_value(json_array_get(sound_pressure_level, i));
 		}
 
-		if(effect->draw != NULL) effect->draw();
+		if (ticks >= next_draw_at) {
+			next_draw_at = ticks + effect->minimum_ticks;
+			tween_end();
+
+			if(effect->draw != NULL) effect->draw();
 
-		// Flip buffers to better simulate the environment
-		gs_buf_swap();
+			// Composite the overlay like the firmware does
+			if (overlay.effect != NULL) {
+				blend_mode = overlay.blend;
+				blend_alpha = overlay.alpha;
+				overlay.effect->draw();
+				blend_mode = BLEND_NONE;
+			}
+
+			// Flip buffers to better simulate the environment
+			if (!jit) {
+				gs_buf_swap();
+				if (effect->tween) tween_flip(gs_buf_back);
+			}
+		}
+		output_refresh();
+
+		/* Run the output stage like the multiplexer does. The
+		 * result is exported in place of front buffer. */
+		uint8_t *const front = gs_buf_front;
+		if (gs_buf_format(front) != OUTPUT_DIRECT || tween_from != NULL) {
+			for (int z=0; z<LEDS_Z; z++) {
+				output_layer(front, z, expanded.data + z * BYTES_PER_LAYER);
+			}
+			gs_buf_dirty(expanded.data) = ALL_LAYERS;
+			gs_buf_front = expanded.data;
+		}
 
 		// Export stuff
 		if (binary) {
 			// Write the raw buffer
 			fwrite(gs_buf_front,GS_BUF_BYTES,1,f);
 		} else {
-			for (int j=0; j<GS_BUF_BYTES; j+=3) {
-				uint16_t fst =
-					gs_buf_front[j] << 4 |
-					gs_buf_front[j+1] >> 4;
-				uint16_t snd =
-					((gs_buf_front[j+1] & 0x0f) << 8) |
-					gs_buf_front[j+2];
-				
-				fprintf(f,"%f,%f,",(float)fst/4095,(float)snd/4095);
+			layer_mask_t dirty = gs_buf_dirty(gs_buf_front);
+			for (int z=0; z<LEDS_Z; z++, dirty >>= 1) {
+				// Black layers need no unpacking
+				if (!(dirty & 1)) {
+					fputs(black_layer,f);
+					continue;
+				}
+
+				for (int y=0; y<LEDS_Y; y++) {
+					for (int x=0; x<LEDS_X; x++) {
+						fprintf(f,"%f,",(float)get_led(x,y,z)/MAX_INTENSITY);
+					}
+				}
 			}
 			
 			// Unwind last comma
 			fseek(f,-1,SEEK_CUR); // TODO handle errors
 			fputs("],[",f); // TODO handle errors
 		}
+
+		gs_buf_front = front;
 	}
 
 	// Return buffers back to original
+	gs_buf_set_format(gs_buf_front, OUTPUT_DIRECT);
+	gs_buf_set_format(gs_buf_back, OUTPUT_DIRECT);
 	if (!effect->flip_buffers) gs_buf_front = old_front;
+	jit_active = false;
+	tween_end();
 
 	if (!binary) {
 		fseek(f,-2,SEEK_CUR); // TODO handle errors
@@ -234,3 +382,16 @@ struct glyph_buf *convert_to_glyphs(const char *text) {
 	}
 	return result;
 }
+
+/* Multiplexer is emulated by copying the layers to the front buffer
+ * in order. There is no need to wait for slots. */
+uint8_t jit_next_layer(void)
+{
+	return jit_z;
+}
+
+void jit_commit(uint8_t z)
+{
+	memcpy(gs_buf_front + z * BYTES_PER_LAYER, jit_slot(z), BYTES_PER_LAYER);
+	jit_z = (z + 1) % LEDS_Z;
+}